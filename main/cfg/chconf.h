@@ -773,7 +773,7 @@
  * @note    This macro can be used to activate a power saving mode.
  */
 #define CH_CFG_IDLE_ENTER_HOOK() {                                          \
-  /* Idle-enter code here.*/                                                \
+  idle_enter();                                                             \
 }
 
 /**
@@ -783,7 +783,7 @@
  * @note    This macro can be used to deactivate a power saving mode.
  */
 #define CH_CFG_IDLE_LEAVE_HOOK() {                                          \
-  /* Idle-leave code here.*/                                                \
+  idle_leave();                                                             \
 }
 
 /**
@@ -791,7 +791,8 @@
  * @details This hook is continuously invoked by the idle thread loop.
  */
 #define CH_CFG_IDLE_LOOP_HOOK() {                                           \
-  /* Idle loop code here.*/                                                 \
+  idle_loop();                                                              \
+  power_idle();                                                             \
 }
 
 /**
@@ -835,6 +836,21 @@
 /* Port-specific settings (override port settings defaulted in chcore.h).    */
 /*===========================================================================*/
 
+#if !defined(_FROM_ASM_)
+/* Idle time measurement, idle.c. */
+void idle_enter(void);
+void idle_leave(void);
+void idle_loop(void);
+/* STOP mode, power.c. */
+void power_idle(void);
+#endif
+
+/* Idle thread sleeps till interrupt. */
+#define CORTEX_ENABLE_WFI_IDLE              TRUE
+
+/* Idle loop hook calls power_idle(), which restarts clocks by stm32_clock_init() after STOP. */
+#define PORT_IDLE_THREAD_STACK_SIZE         128
+
 #endif  /* CHCONF_H */
 
 /** @} */
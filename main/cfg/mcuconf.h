@@ -84,6 +84,12 @@
 #define STM32_CAN_USE_CAN1                  FALSE
 #define STM32_CAN_CAN1_IRQ_PRIORITY         11
 
+/*
+ * DMA settings.
+ * Fade engine allocates DMA1 channel 3 (TIM3 update), none of enabled HAL drivers uses DMA.
+ */
+#define STM32_DMA_REQUIRED
+
 /*
  * GPT driver system settings.
  */
@@ -93,7 +99,7 @@
 #define STM32_GPT_USE_TIM4                  FALSE
 #define STM32_GPT_USE_TIM5                  FALSE
 #define STM32_GPT_USE_TIM8                  FALSE
-#define STM32_GPT_TIM1_IRQ_PRIORITY         7
+#define STM32_GPT_TIM1_IRQ_PRIORITY         6
 #define STM32_GPT_TIM2_IRQ_PRIORITY         7
 #define STM32_GPT_TIM3_IRQ_PRIORITY         7
 #define STM32_GPT_TIM4_IRQ_PRIORITY         7
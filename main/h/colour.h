@@ -0,0 +1,10 @@
+#ifndef COLOUR_H
+#define COLOUR_H
+
+#include <stdint.h>
+
+void colour_set_cct(uint16_t cct); /** CCT in kelvins, limited by CCTs of warm and cool LEDs. */
+uint16_t colour_limit_cct(int32_t cct); /** CCT limited by CCTs of warm and cool LEDs. */
+uint16_t colour_cct(void);
+
+#endif //COLOUR_H
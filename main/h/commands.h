@@ -0,0 +1,10 @@
+#ifndef COMMANDS_H
+#define COMMANDS_H
+
+#include <hal.h>
+
+void commands_initialize(SerialUSBDriver *sdu); /** Start shell on serial over USB. */
+void commands_set_boot_light(uint32_t usec); /** Time from start of main() to lit PWM, reported by "boot" command. */
+void commands_set_boot_usb(uint32_t msec); /** Time from boot to USB connection, reported by "boot" command. */
+
+#endif //COMMANDS_H
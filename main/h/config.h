@@ -5,8 +5,65 @@
 #define IR_PIN            0U
 #define IR_PIN_INVERTED   TRUE
 
-#define PWM_PORT           GPIOA
-#define PWM_PIN            6U
+/* Infrared protocols to decode, disabled ones cost nothing. */
+#define IR_USE_NEC        TRUE
+#define IR_USE_RC5        FALSE
+#define IR_USE_RC6        FALSE
+#define IR_USE_SIRC       FALSE
+#define IR_USE_SAMSUNG32  FALSE
+
+/* Interrupt storm protection: more signal changes per 10 ms disable receiver until signal is quiet. */
+#define IR_STORM_EDGES_MAX     32U
+#define IR_STORM_QUIET_MSEC    100U
+
+/* Flash pages for saved settings, last ones of 128 KB flash, not linked by cfg/STM32F103xB_lamp.ld. */
+#define KEYMAP_FLASH_ADDRESS   0x0801FC00U
+#define LAMP_JOURNAL_ADDRESS   0x0801F800U
+
+/* Last used brightness and CCT are saved when lamp state is not changed for this time, and restored at boot. */
+#define LAMP_SAVE_DELAY_MSEC   5000U
+
+/* Learning of remote keys: presses of the same key to learn it, repeats of ON key to start learning, timeout. */
+#define LEARN_FRAMES           3U
+#define LEARN_COMBO_REPEATS    30U
+#define LEARN_TIMEOUT_MSEC     10000U
+
+/* PWM outputs: channels 0..3 are TIM3 CH1..CH4, channels 4..7 are TIM4 CH1..CH4. Pins of all channels. */
+#define PWM_CHANNELS       1U
+#define PWM_CHANNEL_PINS   {GPIOA, 6U}, {GPIOA, 7U}, {GPIOB, 0U}, {GPIOB, 1U}, {GPIOB, 6U}, {GPIOB, 7U}, {GPIOB, 8U}, {GPIOB, 9U}
 #define PWM_INVERTED       TRUE
+/* Phase staggering: channels are front or back aligned by their duties, to spread supply current over period. */
+#define PWM_STAGGER        TRUE
+
+/* PWM frequency and resolution, timer clock is 48 MHz at most. */
+#define PWM_PROFILE_400HZ  1 /* 4 MHz / 10000 ticks. */
+#define PWM_PROFILE_2KHZ   2 /* 48 MHz / 24000 ticks, no flicker on camera with short exposure. */
+#define PWM_PROFILE_20KHZ  3 /* 48 MHz / 2400 ticks, inaudible, low levels are made by dithering. */
+#define PWM_PROFILE        PWM_PROFILE_400HZ
+/* Brightness curve of PWM levels. */
+#define PWM_CURVE_CIE1931  1 /* CIE 1931 lightness. */
+#define PWM_CURVE_QUADRATIC 2 /* Gamma 2. */
+#define PWM_CURVE_CUBIC    3 /* Gamma 3. */
+#define PWM_CURVE          PWM_CURVE_CIE1931
+/* Sigma-delta dithering of PWM: 1/16 tick resolution and brightness below the shortest pulse of 2.5 us. */
+#define PWM_DITHER         TRUE
+/*
+ * Tunable white: channel 0 is warm white LEDs, channel 1 is cool white LEDs, mixed to CCT with constant luminous flux.
+ * Lamps with warm and cool strips set PWM_CHANNELS 2U and COLOUR_TUNABLE_WHITE TRUE, single string lamps keep it FALSE:
+ * otherwise channel 0 is dimmed by gain of warm LEDs and PA7 is driven.
+ */
+#define COLOUR_TUNABLE_WHITE   FALSE
+#define COLOUR_WARM_CCT        2700U /* CCT of warm white LEDs, K. */
+#define COLOUR_COOL_CCT        6500U /* CCT of cool white LEDs, K. */
+#define COLOUR_WARM_FLUX       900U  /* Luminous flux of warm white LEDs at full duty, lm. */
+#define COLOUR_COOL_FLUX       1000U /* Luminous flux of cool white LEDs at full duty, lm. */
+#define COLOUR_CCT_DEFAULT     4000U
+#define COLOUR_CCT_STEP        100U  /* CCT change per key press and per repeat of holding key, K. */
+/* Power manager: STOP mode while all PWM channels are off and USB is not active, wakeup by IR receiver or USB. */
+#define POWER_STOP             TRUE
+#define POWER_USB_WAKEUP_IRQ_PRIORITY 7
+/* Fade engine sends compare values by DMA, interrupt per 32 PWM periods (128 with 2 kHz and 20 kHz profiles). */
+#define FADE_DMA_IRQ_PRIORITY  7
+#define FADE_DURATION_MAX_MSEC 10000U /* Longer fades are shortened, so fixed point curve fits 64 bits. */
 
 #endif //DOORLOCK_CONFIG_H
@@ -0,0 +1,23 @@
+#ifndef FADE_H
+#define FADE_H
+
+#include <stdint.h>
+#include "ch.h"
+
+#define FADE_EVENT_DONE    1U   /** Event flag, broadcasted when fade reaches its level. */
+#define FADE_GAIN_ONE      (1UL << 16) /** Gain of channel 1.0, Q16. */
+
+typedef enum
+{
+	FADE_LINEAR = 0,        /** Constant speed. */
+	FADE_EASE_IN,           /** Starts slowly. */
+	FADE_EASE_OUT,          /** Stops slowly. */
+	FADE_EASE_IN_OUT,       /** Starts and stops slowly. */
+}fade_curve_t;
+
+void fade_initialize(void); /** Start DMA of compare values, after pwm_initialize(), fade_to() and fade_set_gains() of boot state. */
+void fade_to(uint16_t level, uint32_t duration_msec, fade_curve_t curve); /** Change brightness level 0..PWM_LEVEL_MAX smoothly, keeping speed of current fade. */
+void fade_set_gains(const uint32_t *gains); /** Q16 gains of channels 0..PWM_DMA_CHANNELS-1, applied from the next prepared period. */
+event_source_t *fade_event_source(void);
+
+#endif //FADE_H
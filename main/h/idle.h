@@ -0,0 +1,16 @@
+#ifndef IDLE_H
+#define IDLE_H
+
+#include <stdint.h>
+
+typedef struct
+{
+	uint32_t cycles;                        /** CPU cycle counter at the moment of reading. */
+	uint64_t idle_cycles;                   /** Total CPU cycles in idle thread. */
+	uint32_t wakeups;                       /** Number of WFI exits of idle thread, by any interrupt. */
+	uint32_t switches;                      /** Number of times idle thread was left for another thread. */
+}idle_statistics_t;
+
+void idle_get_statistics(idle_statistics_t *statistics);
+
+#endif //IDLE_H
@@ -2,9 +2,51 @@
 #define IR_H
 #include <stdint.h>
 #include <stdbool.h>
+#include "ch.h"
 
+typedef enum
+{
+	IR_PROTOCOL_NEC = 0,           /** NEC and extended NEC. */
+	IR_PROTOCOL_RC5,               /** Philips RC5, 6 bit command with field bit. */
+	IR_PROTOCOL_RC6,               /** Philips RC6 mode 0. */
+	IR_PROTOCOL_SIRC,              /** Sony SIRC, 12 bit version. */
+	IR_PROTOCOL_SAMSUNG32,         /** Samsung 32 bit. */
+	IR_PROTOCOL_COUNT,             /** Number of protocols. */
+}ir_protocol_t;
+
+typedef struct
+{
+	uint32_t edges;                         /** Decoded signal changes. */
+	uint32_t dropped_edges;                 /** Signal changes lost because decoder thread was late. */
+	uint32_t frames[IR_PROTOCOL_COUNT];     /** Reported commands and repeats, per protocol. */
+	uint32_t decode_cycles_max;             /** Longest decoding of one signal change by all decoders, CPU cycles. */
+	uint32_t decode_cycles_total;           /** Total decoding time, CPU cycles. */
+	uint32_t lost_events;                   /** Events not queued because queue was full. */
+	uint32_t storms;                        /** Number of times receiver was disabled by interrupt storm. */
+}ir_statistics_t;
+
+typedef struct
+{
+	ir_protocol_t  protocol;        /** Protocol of remote. */
+	uint16_t       address;         /** Address of remote. */
+	uint8_t        command;         /** Command, key code. */
+	bool           repeat;          /** True if key is holding. */
+	systimestamp_t time;            /** Monotonic time stamp of reception, system ticks since boot. */
+}ir_event_t;
+
+/** Called from decoder thread, not from interrupt. */
 typedef void (ir_command_callback_t)(void *context, uint16_t address, uint8_t command, bool repeat);
+/** Same as ir_command_callback_t, but with protocol of received command. */
+typedef void (ir_frame_callback_t)(void *context, ir_protocol_t protocol, uint16_t address, uint8_t command, bool repeat);
 void ir_initialize(void);
 void ir_set_callback(ir_command_callback_t *callback, void *context);
+void ir_set_frame_callback(ir_frame_callback_t *callback, void *context);
+void ir_enable_events(void); /** Start queuing of received commands for ir_event_get(). */
+bool ir_event_get(ir_event_t *event, sysinterval_t timeout); /** Returns false on timeout. */
+void ir_wakeup(uint32_t delay_usec); /** Called with interrupts disabled after wakeup from STOP by edge, before the edge interrupt. */
+bool ir_is_quiet(void); /** No signal changes for a frame time and receiver is enabled, so MCU may be stopped. */
+uint32_t ir_dropped_edges(void); /** Number of signal changes lost because decoder thread was late. */
+uint32_t ir_lost_events(void); /** Number of commands not queued for ir_event_get() because queue was full. */
+void ir_get_statistics(ir_statistics_t *statistics);
 
 #endif //IR_H
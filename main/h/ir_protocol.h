@@ -0,0 +1,203 @@
+#ifndef IR_PROTOCOL_H
+#define IR_PROTOCOL_H
+#include <stdint.h>
+#include <stdbool.h>
+#include "ir.h"
+
+/*
+ * Interface between edge capture in ir.c and protocol decoders.
+ * Every enabled decoder receives every signal change and keeps its own state,
+ * so several protocols may be received by the same receiver.
+ */
+
+#define IR_TICKS_PER_USEC     4u                  /** Timer ticks per microsecond. */
+#define IR_TICKS_PER_MSEC     4000u               /** Timer ticks per millisecond. */
+#define IR_EDGE_TIME_MASK     0x7fffffffu         /** Edge timestamp bits. */
+
+#define IR_USEC(x)            ((x) * IR_TICKS_PER_USEC)     /** Microseconds to ticks. */
+#define IR_MIN_TICKS(x)       (IR_USEC(x) * 3u / 4u)        /** Shortest accepted duration of nominal x microseconds. */
+#define IR_MAX_TICKS(x)       (IR_USEC(x) * 5u / 4u)        /** Longest accepted duration of nominal x microseconds. */
+
+typedef struct
+{
+	ir_protocol_t  protocol;        /** Protocol, filled by ir.c. */
+	uint16_t       address;         /** Address of remote. */
+	uint8_t        command;         /** Command, key code. */
+	bool           repeat;          /** True if key is holding. */
+}ir_frame_t;
+
+/**
+ * Feed decoder with signal change.
+ * pulse - true if ended level was pulse (carrier present), false if space.
+ * duration - duration of ended level, ticks.
+ * now - timestamp of signal change, ticks.
+ * Returns true when frame is filled.
+ */
+typedef bool (ir_decode_t)(bool pulse, uint32_t duration, uint32_t now, ir_frame_t *frame);
+
+typedef struct
+{
+	ir_protocol_t  protocol;        /** Protocol of decoder. */
+	ir_decode_t    *decode;         /** Decoder function. */
+}ir_decoder_t;
+
+bool ir_nec_decode(bool pulse, uint32_t duration, uint32_t now, ir_frame_t *frame);
+bool ir_rc5_decode(bool pulse, uint32_t duration, uint32_t now, ir_frame_t *frame);
+bool ir_rc6_decode(bool pulse, uint32_t duration, uint32_t now, ir_frame_t *frame);
+bool ir_sirc_decode(bool pulse, uint32_t duration, uint32_t now, ir_frame_t *frame);
+bool ir_samsung_decode(bool pulse, uint32_t duration, uint32_t now, ir_frame_t *frame);
+
+static inline bool ir_in_range(uint32_t duration, uint32_t min_ticks, uint32_t max_ticks)
+{
+	return (duration > min_ticks) && (duration < max_ticks);
+}
+
+/** Ticks from one timestamp to another, timestamps wrap around IR_EDGE_TIME_MASK. */
+static inline uint32_t ir_elapsed(uint32_t now, uint32_t since)
+{
+	return (now - since) & IR_EDGE_TIME_MASK;
+}
+
+/*
+ * Pulse distance coding (NEC, Samsung): pulse of one bit period,
+ * space of one bit period is logic zero and of three bit periods is logic one.
+ * Bit period is tracked on every pulse begin from duration of pulse and space,
+ * so remote with inaccurate or drifting oscillator is received until end of frame.
+ * Pulse plus space does not depend on receiver distortion of pulse width.
+ * Thresholds are shifts of bit period at comparison, so tracking stores the period only.
+ */
+typedef struct
+{
+	uint32_t       ticks_per_bit;      /** Tracked duration of bit period. */
+	uint32_t       pulse_ticks;        /** Duration of last data pulse. */
+	uint32_t       frame;              /** Received bits, first received bit is least significant. */
+	uint8_t        bits_received;      /** Number of received data bits. */
+}ir_pulse_distance_t;
+
+/** Start of data, bit period is measured by synchronization. */
+static inline void ir_pulse_distance_start(ir_pulse_distance_t *pd, uint32_t ticks_per_bit)
+{
+	pd->ticks_per_bit = ticks_per_bit;
+	pd->pulse_ticks = ticks_per_bit;
+	pd->frame = 0;
+	pd->bits_received = 0;
+}
+
+/**
+ * Correct bit period by measured one, like frequency locked loop:
+ * error is limited by 1/8 of period and half of it is applied.
+ */
+static inline void ir_pulse_distance_track(ir_pulse_distance_t *pd, uint32_t measured_ticks_per_bit)
+{
+	const int32_t limit = (int32_t)(pd->ticks_per_bit >> 3);
+	int32_t error = (int32_t)measured_ticks_per_bit - (int32_t)pd->ticks_per_bit;
+
+	if (error > limit)
+	{
+		error = limit;
+	}
+	else if (error < -limit)
+	{
+		error = -limit;
+	}
+	pd->ticks_per_bit = (uint32_t)((int32_t)pd->ticks_per_bit + error / 2);
+}
+
+/** Returns false if duration is not valid for data bit. */
+static inline bool ir_pulse_distance_push(ir_pulse_distance_t *pd, bool pulse, uint32_t duration)
+{
+	const uint32_t period = pd->ticks_per_bit;
+
+	if (pulse)
+	{
+		/* Data pulse is half to two bit periods, shorter one is glitch. */
+		pd->pulse_ticks = duration;
+		return ir_in_range(duration, period >> 1, period << 1);
+	}
+
+	/* Space ends by pulse begin, so whole bit is known. Shorter than 1.5 bit periods is split by glitch. */
+	const uint32_t bit_ticks = pd->pulse_ticks + duration;
+	if ((bit_ticks >= (period << 2) + period) || (bit_ticks <= period + (period >> 1)))
+	{
+		return false;
+	}
+	pd->frame >>= 1;
+	if (bit_ticks >= (period << 1) + period)
+	{
+		/* Logic one is four bit periods. */
+		pd->frame |= 0x80000000u;
+		ir_pulse_distance_track(pd, bit_ticks >> 2);
+	}
+	else
+	{
+		/* Logic zero is two bit periods. */
+		ir_pulse_distance_track(pd, bit_ticks >> 1);
+	}
+	pd->bits_received++;
+	return true;
+}
+
+/*
+ * Bi-phase coding (RC5, RC6): signal is sampled in units of half bit,
+ * every level lasts for one or several units.
+ */
+typedef struct
+{
+	uint64_t       levels;        /** Level of every received unit, last unit is least significant. */
+	uint8_t        count;         /** Number of received units. */
+}ir_units_t;
+
+static inline void ir_units_push(ir_units_t *units, bool pulse, uint8_t count)
+{
+	while (count--)
+	{
+		units->levels = (units->levels << 1) | (pulse ? 1u : 0u);
+		units->count++;
+	}
+}
+
+/**
+ * Number of units in duration.
+ * Tolerance is 3/8 of unit for one unit and grows by 1/8 of unit for every next one.
+ * Returns 0 if duration is out of 1..max_units or between them.
+ */
+static inline uint8_t ir_units_count(uint32_t duration, uint32_t unit_ticks, uint8_t max_units)
+{
+	uint32_t tolerance = (unit_ticks >> 2) + (unit_ticks >> 3);
+	uint32_t nominal = unit_ticks;
+	uint8_t count;
+
+	for (count = 1; count <= max_units; count++)
+	{
+		if ((duration > nominal - tolerance) && (duration < nominal + tolerance))
+		{
+			return count;
+		}
+		nominal += unit_ticks;
+		tolerance += unit_ticks >> 3;
+	}
+	return 0;
+}
+
+/** Level of unit, index 0 is first received unit. */
+static inline bool ir_units_level(const ir_units_t *units, uint8_t index)
+{
+	return ((units->levels >> (units->count - 1u - index)) & 1u) != 0;
+}
+
+/**
+ * Decode bi-phase bit from two halves of width units.
+ * Returns level of second half or -1 if halves are equal.
+ */
+static inline int ir_units_bit(const ir_units_t *units, uint8_t index, uint8_t width)
+{
+	const bool first = ir_units_level(units, index);
+	const bool second = ir_units_level(units, index + width);
+	if (first == second)
+	{
+		return -1;
+	}
+	return second ? 1 : 0;
+}
+
+#endif //IR_PROTOCOL_H
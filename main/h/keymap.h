@@ -0,0 +1,39 @@
+#ifndef KEYMAP_H
+#define KEYMAP_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define KEYMAP_ENTRIES_MAX    64u  /** Number of bindings. */
+
+typedef enum
+{
+	KEYMAP_ACTION_NONE = 0,    /** Unknown key, also marks free slot. */
+	KEYMAP_ACTION_OFF,
+	KEYMAP_ACTION_ON,
+	KEYMAP_ACTION_PLUS,
+	KEYMAP_ACTION_MINUS,
+	KEYMAP_ACTION_WARMER,      /** Lower CCT of tunable white. */
+	KEYMAP_ACTION_COOLER,      /** Higher CCT of tunable white. */
+	KEYMAP_ACTION_COUNT,       /** Number of actions. */
+}keymap_action_t;
+
+typedef struct
+{
+	uint16_t address;          /** Address of remote. */
+	uint8_t  command;          /** Command, key code. */
+	uint8_t  action;           /** keymap_action_t, one byte to keep entry in one word. */
+}keymap_entry_t;
+
+void keymap_initialize(void); /** Load saved keymap from flash, or default one. */
+keymap_action_t keymap_lookup(uint16_t address, uint8_t command);
+bool keymap_bind(uint16_t address, uint8_t command, keymap_action_t action); /** Returns false if table is full. */
+bool keymap_unbind(uint16_t address, uint8_t command); /** Returns false if key is not bound. */
+void keymap_reset(void); /** Replace keymap by default one, without saving. */
+bool keymap_save(void); /** Write keymap to flash. */
+size_t keymap_get(keymap_entry_t *entries, size_t size); /** Copy bindings, returns number of copied ones. */
+const char *keymap_action_name(keymap_action_t action);
+keymap_action_t keymap_action_parse(const char *name); /** Returns KEYMAP_ACTION_NONE for unknown name. */
+
+#endif //KEYMAP_H
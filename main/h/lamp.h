@@ -0,0 +1,25 @@
+#ifndef LAMP_H
+#define LAMP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ch.h"
+
+#define LAMP_EVENT_CHANGED    1U   /** Event flag, broadcasted when changed state is published. */
+
+typedef struct
+{
+	bool     on;                   /** Lamp is switched on. */
+	uint8_t  brightness;           /** Brightness when switched on, percents. */
+	uint16_t cct;                  /** CCT of tunable white, K. */
+}lamp_state_t;
+
+void lamp_initialize(void);
+lamp_state_t *lamp_begin(void); /** Locks other writers, returns copy of state to change. */
+void lamp_commit(void); /** Publishes changed copy and unlocks writers. */
+void lamp_get(lamp_state_t *state); /** Consistent copy of published state, without locks, also from interrupt. */
+bool lamp_load(lamp_state_t *state); /** Brightness and CCT of the last saved state, false if nothing is saved. */
+bool lamp_save(void); /** Appends published brightness and CCT to flash journal if they differ from saved ones. */
+event_source_t *lamp_event_source(void);
+
+#endif //LAMP_H
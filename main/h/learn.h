@@ -0,0 +1,13 @@
+#ifndef LEARN_H
+#define LEARN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ch.h"
+#include "ir.h"
+
+void learn_initialize(void);
+bool learn_event(const ir_event_t *event); /** Called by remote thread for every event, returns true if event is taken by learning. */
+bool learn_capture(uint8_t frames, sysinterval_t timeout, uint16_t *address, uint8_t *command); /** Wait for key pressed frames times, returns false on timeout. */
+
+#endif //LEARN_H
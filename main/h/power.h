@@ -0,0 +1,19 @@
+#ifndef POWER_H
+#define POWER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct
+{
+	uint32_t stops;                         /** Number of times MCU was stopped. */
+	uint32_t ir_wakeups;                    /** Wakeups by infrared receiver. */
+	uint32_t wakeup_usec;                   /** Delay of the last wakeup by clock restart, microseconds. */
+}power_statistics_t;
+
+void power_initialize(void); /** Allows STOP mode, before threads which use power manager are started. */
+void power_set_dark(bool dark); /** Lamp is dark when all PWM channels are off, set by brightness thread. */
+void power_wait_light(void); /** Blocks thread while lamp is dark. */
+void power_get_statistics(power_statistics_t *statistics);
+
+#endif //POWER_H
@@ -2,11 +2,52 @@
 #define PWM_H
 
 #include <stdint.h>
+#include <stdbool.h>
+#include "config.h"
+
+#if !defined(PWM_PROFILE)
+#error PWM profile is not configured!
+#elif PWM_PROFILE == PWM_PROFILE_400HZ
+#define PWM_FREQUENCY              4000000U  /** 4 MHz timer clock. */
+#define PWM_PERIOD                 10000U    /** 400 Hz PWM frequency. */
+#elif PWM_PROFILE == PWM_PROFILE_2KHZ
+#define PWM_FREQUENCY              48000000U /** Timer clock is not divided. */
+#define PWM_PERIOD                 24000U    /** 2 kHz PWM frequency. */
+#elif PWM_PROFILE == PWM_PROFILE_20KHZ
+#define PWM_FREQUENCY              48000000U /** Timer clock is not divided. */
+#define PWM_PERIOD                 2400U     /** 20 kHz PWM frequency. */
+#else
+#error Unknown PWM profile!
+#endif
+#if COLOUR_TUNABLE_WHITE == TRUE
+#define PWM_DMA_CHANNELS           2U        /** Warm and cool white channels are written by DMA of fade engine. */
+#else
+#define PWM_DMA_CHANNELS           1U        /** Channel 0 is written by DMA of fade engine. */
+#endif
+#if (PWM_STAGGER == TRUE) && (PWM_DMA_CHANNELS > 1U)
+#define PWM_DMA_BACK_CHANNELS      0x2U      /** Channel 1 is back aligned, fade engine writes PWM_PERIOD - duty to it. */
+#else
+#define PWM_DMA_BACK_CHANNELS      0U
+#endif
+#define PWM_FRACTION_BITS          4U        /** Compare values with fraction are in 1/16 of timer tick. */
+#define PWM_LEVEL_MAX              1023U  /** Brightness levels are perceptually uniform. */
+#define PWM_PERCENT_TO_LEVEL(p)    ((uint16_t)(((uint32_t)(p) * PWM_LEVEL_MAX + 50U) / 100U))
 
 typedef void (pwm_callback_t)(void *context, bool rising);
 
-void pwm_set(uint16_t value);
-void pwm_corrected_set(uint8_t value);
+typedef struct
+{
+	uint32_t percentage_cycles;        /** CPU cycles of compare value update by PWM_PERCENTAGE_TO_WIDTH(). */
+	uint32_t ticks_cycles;             /** CPU cycles of pwm_ticks_set(), 0 if all channels are written by DMA. */
+}pwm_benchmark_t;
+
+void pwm_ticks_set(uint32_t channel, uint16_t ticks); /** Duty in timer ticks 0..PWM_PERIOD of channel not written by fade engine, values below 2.5 us are not limited, alignment is kept. */
+void pwm_set_channels(const uint16_t *values, uint32_t mask); /** Duties of channels in mask, not written by fade engine, changed in the same PWM period. */
+bool pwm_is_off(void); /** All channels are at zero. */
+uint32_t pwm_level_ticks(uint16_t level); /** Compare value of level, with fraction. */
+uint16_t pwm_quantize(int32_t *error, uint32_t ticks); /** Compare value of next period for value with fraction, error is kept by caller. */
+uint16_t pwm_pattern(uint32_t target, uint32_t index, uint32_t periods); /** Compare value of period index of steady pattern repeated every periods, a multiple of 16. */
+void pwm_benchmark(pwm_benchmark_t *result); /** Measures update of channel 0 by PWM_PERCENTAGE_TO_WIDTH() and of the last channel by pwm_ticks_set(). */
 void pwm_initialize(void);
 
 #endif //PWM_H
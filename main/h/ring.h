@@ -0,0 +1,53 @@
+#ifndef RING_H
+#define RING_H
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Indexes of single producer, single consumer lock free ring buffer.
+ * Storage is owned by user, its size must be power of two.
+ * Head is written only by producer and tail only by consumer, so no locks are needed.
+ */
+typedef struct
+{
+	volatile uint32_t head;      /** Number of pushed elements. */
+	volatile uint32_t tail;      /** Number of popped elements. */
+}ring_t;
+
+static inline bool ring_is_empty(const ring_t *ring)
+{
+	return ring->head == ring->tail;
+}
+
+static inline bool ring_is_full(const ring_t *ring, uint32_t size)
+{
+	return (ring->head - ring->tail) >= size;
+}
+
+/** Index of slot to be filled by producer. */
+static inline uint32_t ring_head_index(const ring_t *ring, uint32_t size)
+{
+	return ring->head & (size - 1);
+}
+
+/** Index of slot to be read by consumer. */
+static inline uint32_t ring_tail_index(const ring_t *ring, uint32_t size)
+{
+	return ring->tail & (size - 1);
+}
+
+/** Publish filled slot to consumer. */
+static inline void ring_push(ring_t *ring)
+{
+	__sync_synchronize(); /* Slot must be written before it becomes visible. */
+	ring->head = ring->head + 1;
+}
+
+/** Release read slot to producer. */
+static inline void ring_pop(ring_t *ring)
+{
+	__sync_synchronize(); /* Slot must be read before it may be overwritten. */
+	ring->tail = ring->tail + 1;
+}
+
+#endif //RING_H
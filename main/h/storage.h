@@ -0,0 +1,15 @@
+#ifndef STORAGE_H
+#define STORAGE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define STORAGE_PAGE_SIZE    1024u  /** Erase unit of STM32F103 medium density flash. */
+
+void storage_initialize(void);
+bool storage_erase(uint32_t address); /** Erase flash page at address, all bytes become 0xFF. */
+bool storage_write(uint32_t address, const void *data, size_t size); /** Program erased flash by halfwords, address must be even. */
+const void *storage_pointer(uint32_t address); /** Flash is memory mapped, so read it by pointer. */
+
+#endif //STORAGE_H
@@ -0,0 +1,91 @@
+#include <hal.h>
+#include "ch.h"
+#include "colour.h"
+#include "fade.h"
+#include "pwm.h"
+#include "config.h"
+
+#if COLOUR_TUNABLE_WHITE == TRUE
+
+#if !defined(COLOUR_WARM_CCT) || !defined(COLOUR_COOL_CCT) || !defined(COLOUR_WARM_FLUX) || !defined(COLOUR_COOL_FLUX) || \
+    !defined(COLOUR_CCT_DEFAULT) || (COLOUR_WARM_CCT >= COLOUR_COOL_CCT)
+#error Tunable white is not configured!
+#endif
+
+/*
+ * Mixing of warm and cool white.
+ * CCT of mix is approximated by interpolation of reciprocal CCT (mired) by luminous flux of channels,
+ * so flux share of cool channel is (M_warm - M) / (M_warm - M_cool).
+ * Total flux is constant, flux of the weaker channel, so each channel is at full duty at its own CCT at most.
+ * Gains are evaluated by compiler at COLOUR_POINTS CCTs, they are interpolated linearly at runtime.
+ */
+#define COLOUR_POINTS              33U
+#define COLOUR_FRACTION_BITS       8U
+#define COLOUR_RANGE               (COLOUR_COOL_CCT - COLOUR_WARM_CCT)
+#define COLOUR_FLUX                ((COLOUR_WARM_FLUX < COLOUR_COOL_FLUX) ? COLOUR_WARM_FLUX : COLOUR_COOL_FLUX)
+#define COLOUR_POINT_CCT(point)    (COLOUR_WARM_CCT + (double)COLOUR_RANGE * (point) / (COLOUR_POINTS - 1U))
+#define COLOUR_MIRED(cct)          (1000000.0 / (cct))
+#define COLOUR_COOL_SHARE(point)   ((COLOUR_MIRED(COLOUR_WARM_CCT) - COLOUR_MIRED(COLOUR_POINT_CCT(point))) / \
+                                    (COLOUR_MIRED(COLOUR_WARM_CCT) - COLOUR_MIRED(COLOUR_COOL_CCT)))
+#define COLOUR_GAIN(share, flux)   ((uint32_t)((share) * COLOUR_FLUX / (flux) * FADE_GAIN_ONE + 0.5))
+
+#define COLOUR_POINTS_1(point)     { COLOUR_GAIN(1.0 - COLOUR_COOL_SHARE(point), COLOUR_WARM_FLUX), COLOUR_GAIN(COLOUR_COOL_SHARE(point), COLOUR_COOL_FLUX) },
+#define COLOUR_POINTS_4(point)     COLOUR_POINTS_1(point) COLOUR_POINTS_1((point) + 1) COLOUR_POINTS_1((point) + 2) COLOUR_POINTS_1((point) + 3)
+#define COLOUR_POINTS_16(point)    COLOUR_POINTS_4(point) COLOUR_POINTS_4((point) + 4) COLOUR_POINTS_4((point) + 8) COLOUR_POINTS_4((point) + 12)
+
+/** Gains of warm and cool channels, Q16, at CCTs from warm to cool evenly. */
+static const uint32_t colour_gains[COLOUR_POINTS][PWM_DMA_CHANNELS] =
+{
+	COLOUR_POINTS_16(0)
+	COLOUR_POINTS_16(16)
+	COLOUR_POINTS_1(32)
+};
+
+static struct
+{
+	uint16_t cct;                       /** Current CCT, K. */
+}colour_context;
+
+void colour_set_cct(uint16_t cct)
+{
+	uint32_t gains[PWM_DMA_CHANNELS];
+	uint32_t position;
+	uint32_t index;
+	int32_t fraction;
+	uint32_t channel;
+
+	cct = colour_limit_cct(cct);
+
+	/* Position between points with fraction, division by constant is multiplication. */
+	position = (((uint32_t)(cct - COLOUR_WARM_CCT) * (COLOUR_POINTS - 1U)) << COLOUR_FRACTION_BITS) / COLOUR_RANGE;
+	index = position >> COLOUR_FRACTION_BITS;
+	fraction = (int32_t)(position & ((1U << COLOUR_FRACTION_BITS) - 1U));
+	if (index >= COLOUR_POINTS - 1U)
+	{
+		index = COLOUR_POINTS - 2U;
+		fraction = 1 << COLOUR_FRACTION_BITS;
+	}
+
+	for (channel = 0; channel < PWM_DMA_CHANNELS; channel++)
+	{
+		const int32_t g0 = (int32_t)colour_gains[index][channel];
+		const int32_t g1 = (int32_t)colour_gains[index + 1U][channel];
+		gains[channel] = (uint32_t)(g0 + (((g1 - g0) * fraction) >> COLOUR_FRACTION_BITS));
+	}
+	colour_context.cct = cct;
+	fade_set_gains(gains);
+}
+
+uint16_t colour_limit_cct(int32_t cct)
+{
+	if (cct < (int32_t)COLOUR_WARM_CCT) { cct = COLOUR_WARM_CCT; }
+	if (cct > (int32_t)COLOUR_COOL_CCT) { cct = COLOUR_COOL_CCT; }
+	return (uint16_t)cct;
+}
+
+uint16_t colour_cct(void)
+{
+	return colour_context.cct;
+}
+
+#endif
@@ -0,0 +1,407 @@
+#include <hal.h>
+#include <stdlib.h>
+#include "ch.h"
+#include "chprintf.h"
+#include "shell.h"
+#include "commands.h"
+#include "keymap.h"
+#include "learn.h"
+#include "pwm.h"
+#include "colour.h"
+#include "idle.h"
+#include "ir.h"
+#include "lamp.h"
+#include "power.h"
+#include "config.h"
+
+/*
+ * Shell commands over serial over USB.
+ * Shell exits when USB is disconnected, so supervisor thread starts it again.
+ */
+static void commands_keys(BaseSequentialStream *chp, int argc, char *argv[]);
+static void commands_bind(BaseSequentialStream *chp, int argc, char *argv[]);
+static void commands_unbind(BaseSequentialStream *chp, int argc, char *argv[]);
+static void commands_save(BaseSequentialStream *chp, int argc, char *argv[]);
+static void commands_defaults(BaseSequentialStream *chp, int argc, char *argv[]);
+static void commands_learn(BaseSequentialStream *chp, int argc, char *argv[]);
+static void commands_pwmbench(BaseSequentialStream *chp, int argc, char *argv[]);
+static void commands_idle(BaseSequentialStream *chp, int argc, char *argv[]);
+static void commands_irstats(BaseSequentialStream *chp, int argc, char *argv[]);
+static void commands_boot(BaseSequentialStream *chp, int argc, char *argv[]);
+#if COLOUR_TUNABLE_WHITE == TRUE
+static void commands_cct(BaseSequentialStream *chp, int argc, char *argv[]);
+#endif
+
+static const ShellCommand commands_list[] =
+{
+	{ "keys", commands_keys },
+	{ "bind", commands_bind },
+	{ "unbind", commands_unbind },
+	{ "save", commands_save },
+	{ "defaults", commands_defaults },
+	{ "learn", commands_learn },
+	{ "pwmbench", commands_pwmbench },
+	{ "idle", commands_idle },
+	{ "irstats", commands_irstats },
+	{ "boot", commands_boot },
+#if COLOUR_TUNABLE_WHITE == TRUE
+	{ "cct", commands_cct },
+#endif
+	{ NULL, NULL },
+};
+
+static struct
+{
+	SerialUSBDriver *sdu;
+	ShellConfig shell_config;
+	keymap_entry_t keys[KEYMAP_ENTRIES_MAX];    /** Copy of keymap for listing. */
+	uint32_t boot_light_usec;                   /** Time from start of main() to lit PWM. */
+	uint32_t boot_usb_msec;                     /** Time from boot to USB connection. */
+}commands_context;
+
+static THD_WORKING_AREA(area_shell_thread, 1024);
+static THD_WORKING_AREA(area_commands_thread, 128);
+
+static bool commands_parse(const char *text, uint32_t max, uint32_t *value)
+{
+	char *end;
+	const unsigned long result = strtoul(text, &end, 0); /** Decimal or 0x prefixed hexadecimal. */
+
+	if ((*text == '\0') || (*end != '\0') || (result > max))
+	{
+		return false;
+	}
+	*value = (uint32_t)result;
+	return true;
+}
+
+static bool commands_parse_key(BaseSequentialStream *chp, char *argv[], uint16_t *address, uint8_t *command)
+{
+	uint32_t value_address;
+	uint32_t value_command;
+
+	if (!commands_parse(argv[0], 0xFFFFu, &value_address) || !commands_parse(argv[1], 0xFFu, &value_command))
+	{
+		chprintf(chp, "wrong address or command\r\n");
+		return false;
+	}
+	*address = (uint16_t)value_address;
+	*command = (uint8_t)value_command;
+	return true;
+}
+
+static void commands_keys(BaseSequentialStream *chp, int argc, char *argv[])
+{
+	const keymap_entry_t *entries = commands_context.keys;
+	size_t count;
+	size_t i;
+	(void)argv;
+
+	if (argc != 0)
+	{
+		chprintf(chp, "Usage: keys\r\n");
+		return;
+	}
+	count = keymap_get(commands_context.keys, KEYMAP_ENTRIES_MAX);
+	for (i = 0; i < count; i++)
+	{
+		chprintf(chp, "address 0x%04X, command 0x%02X: %s\r\n", entries[i].address, entries[i].command,
+		         keymap_action_name((keymap_action_t)entries[i].action));
+	}
+	chprintf(chp, "%u of %u keys\r\n", (unsigned)count, (unsigned)KEYMAP_ENTRIES_MAX);
+}
+
+static void commands_bind(BaseSequentialStream *chp, int argc, char *argv[])
+{
+	uint16_t address;
+	uint8_t command;
+	keymap_action_t action;
+
+	if (argc != 3)
+	{
+		chprintf(chp, "Usage: bind <address> <command> off|on|plus|minus|warmer|cooler\r\n");
+		return;
+	}
+	action = keymap_action_parse(argv[2]);
+	if (action == KEYMAP_ACTION_NONE)
+	{
+		chprintf(chp, "unknown action %s\r\n", argv[2]);
+		return;
+	}
+	if (commands_parse_key(chp, argv, &address, &command) && !keymap_bind(address, command, action))
+	{
+		chprintf(chp, "keymap is full\r\n");
+	}
+}
+
+static void commands_unbind(BaseSequentialStream *chp, int argc, char *argv[])
+{
+	uint16_t address;
+	uint8_t command;
+
+	if (argc != 2)
+	{
+		chprintf(chp, "Usage: unbind <address> <command>\r\n");
+		return;
+	}
+	if (commands_parse_key(chp, argv, &address, &command) && !keymap_unbind(address, command))
+	{
+		chprintf(chp, "key is not bound\r\n");
+	}
+}
+
+static void commands_save(BaseSequentialStream *chp, int argc, char *argv[])
+{
+	(void)argv;
+	if (argc != 0)
+	{
+		chprintf(chp, "Usage: save\r\n");
+		return;
+	}
+	chprintf(chp, keymap_save() ? "saved\r\n" : "flash error\r\n");
+}
+
+static void commands_defaults(BaseSequentialStream *chp, int argc, char *argv[])
+{
+	(void)argv;
+	if (argc != 0)
+	{
+		chprintf(chp, "Usage: defaults\r\n");
+		return;
+	}
+	keymap_reset();
+}
+
+/* Read line with echo, returns false if stream is closed. */
+static bool commands_read_line(BaseSequentialStream *chp, char *line, size_t size)
+{
+	size_t length = 0;
+
+	while (true)
+	{
+		const msg_t c = streamGet(chp);
+		if (c < 0)
+		{
+			return false;
+		}
+		if ((c == '\r') || (c == '\n'))
+		{
+			chprintf(chp, "\r\n");
+			line[length] = '\0';
+			return true;
+		}
+		if (((c == '\b') || (c == 0x7F)) && (length > 0))
+		{
+			chprintf(chp, "\b \b");
+			length--;
+		}
+		else if ((c >= ' ') && (c < 0x7F) && (length < size - 1))
+		{
+			streamPut(chp, (uint8_t)c);
+			line[length++] = (char)c;
+		}
+	}
+}
+
+static void commands_learn(BaseSequentialStream *chp, int argc, char *argv[])
+{
+	uint32_t frames = LEARN_FRAMES;
+	uint16_t address;
+	uint8_t command;
+	keymap_action_t action;
+	char line[16];
+
+	if ((argc > 1) || ((argc == 1) && (!commands_parse(argv[0], 16, &frames) || (frames == 0))))
+	{
+		chprintf(chp, "Usage: learn [presses 1..16]\r\n");
+		return;
+	}
+	chprintf(chp, "press the key %u times\r\n", (unsigned)frames);
+	if (!learn_capture((uint8_t)frames, TIME_MS2I(LEARN_TIMEOUT_MSEC), &address, &command))
+	{
+		chprintf(chp, "timeout\r\n");
+		return;
+	}
+	chprintf(chp, "address 0x%04X, command 0x%02X, action (off|on|plus|minus|warmer|cooler): ", address, command);
+	if (!commands_read_line(chp, line, sizeof(line)))
+	{
+		return;
+	}
+	action = keymap_action_parse(line);
+	if (action == KEYMAP_ACTION_NONE)
+	{
+		chprintf(chp, "cancelled\r\n");
+		return;
+	}
+	if (!keymap_bind(address, command, action))
+	{
+		chprintf(chp, "keymap is full\r\n");
+		return;
+	}
+	chprintf(chp, keymap_save() ? "saved\r\n" : "flash error\r\n");
+}
+
+static void commands_pwmbench(BaseSequentialStream *chp, int argc, char *argv[])
+{
+	pwm_benchmark_t result;
+	(void)argv;
+
+	if (argc != 0)
+	{
+		chprintf(chp, "Usage: pwmbench\r\n");
+		return;
+	}
+	pwm_benchmark(&result);
+	chprintf(chp, "percentage: %u cycles, ticks: %u cycles\r\n",
+	         (unsigned)result.percentage_cycles, (unsigned)result.ticks_cycles);
+}
+
+/* Cycle counter wraps in 89 s at 48 MHz, so measurement is shorter. Cycle counter is stopped in STOP mode. */
+static void commands_idle(BaseSequentialStream *chp, int argc, char *argv[])
+{
+	uint32_t seconds = 1;
+	idle_statistics_t start;
+	idle_statistics_t end;
+	power_statistics_t power;
+	uint32_t cycles;
+	uint32_t idle_permille;
+
+	if ((argc > 1) || ((argc == 1) && (!commands_parse(argv[0], 60, &seconds) || (seconds == 0))))
+	{
+		chprintf(chp, "Usage: idle [seconds 1..60]\r\n");
+		return;
+	}
+	idle_get_statistics(&start);
+	chThdSleepSeconds(seconds);
+	idle_get_statistics(&end);
+
+	cycles = end.cycles - start.cycles;
+	idle_permille = (uint32_t)((end.idle_cycles - start.idle_cycles) * 1000u / cycles);
+	chprintf(chp, "idle %u.%u %%, %u wakeups, %u thread switches in %u s\r\n",
+	         (unsigned)(idle_permille / 10u), (unsigned)(idle_permille % 10u),
+	         (unsigned)(end.wakeups - start.wakeups), (unsigned)(end.switches - start.switches), (unsigned)seconds);
+	power_get_statistics(&power);
+	chprintf(chp, "stops %u, by IR %u, last wakeup %u us\r\n",
+	         (unsigned)power.stops, (unsigned)power.ir_wakeups, (unsigned)power.wakeup_usec);
+}
+
+/* Counters of infrared receiver since boot, decoding cycles include callbacks of received commands. */
+static void commands_irstats(BaseSequentialStream *chp, int argc, char *argv[])
+{
+	static const char * const protocols[IR_PROTOCOL_COUNT] =
+	{
+		[IR_PROTOCOL_NEC] = "NEC",
+		[IR_PROTOCOL_RC5] = "RC5",
+		[IR_PROTOCOL_RC6] = "RC6",
+		[IR_PROTOCOL_SIRC] = "SIRC",
+		[IR_PROTOCOL_SAMSUNG32] = "Samsung32",
+	};
+	ir_statistics_t statistics;
+	int protocol;
+	(void)argv;
+
+	if (argc != 0)
+	{
+		chprintf(chp, "Usage: irstats\r\n");
+		return;
+	}
+	ir_get_statistics(&statistics);
+	chprintf(chp, "edges %u, dropped %u, storms %u, lost events %u\r\n",
+	         (unsigned)statistics.edges, (unsigned)statistics.dropped_edges,
+	         (unsigned)statistics.storms, (unsigned)statistics.lost_events);
+	chprintf(chp, "decoding %u cycles per edge, max %u cycles\r\n",
+	         (unsigned)(statistics.edges ? statistics.decode_cycles_total / statistics.edges : 0u),
+	         (unsigned)statistics.decode_cycles_max);
+	for (protocol = 0; protocol < IR_PROTOCOL_COUNT; protocol++)
+	{
+		chprintf(chp, "%s frames %u\r\n", protocols[protocol], (unsigned)statistics.frames[protocol]);
+	}
+}
+
+/* Time before main() is not counted: startup code and clock initialization, less than a millisecond. */
+static void commands_boot(BaseSequentialStream *chp, int argc, char *argv[])
+{
+	(void)argv;
+
+	if (argc != 0)
+	{
+		chprintf(chp, "Usage: boot\r\n");
+		return;
+	}
+	chprintf(chp, "light in %u us, USB connected in %u ms\r\n",
+	         (unsigned)commands_context.boot_light_usec, (unsigned)commands_context.boot_usb_msec);
+}
+
+#if COLOUR_TUNABLE_WHITE == TRUE
+static void commands_cct(BaseSequentialStream *chp, int argc, char *argv[])
+{
+	uint32_t cct;
+	lamp_state_t state;
+
+	if ((argc > 1) || ((argc == 1) && !commands_parse(argv[0], COLOUR_COOL_CCT, &cct)))
+	{
+		chprintf(chp, "Usage: cct [%u..%u]\r\n", COLOUR_WARM_CCT, COLOUR_COOL_CCT);
+		return;
+	}
+	if (argc == 1)
+	{
+		lamp_begin()->cct = colour_limit_cct((int32_t)cct);
+		lamp_commit();
+	}
+	lamp_get(&state);
+	chprintf(chp, "%u K\r\n", (unsigned)state.cct);
+}
+#endif
+
+static THD_FUNCTION(commands_thread, arg)
+{
+	event_listener_t listener;
+	(void)arg;
+	chRegSetThreadName("commands");
+
+	/* Registered before the first state check, so a connection in between is not missed. */
+	chEvtRegisterMaskWithFlags(chnGetEventSource(commands_context.sdu), &listener, EVENT_MASK(0), CHN_CONNECTED);
+
+	while (true)
+	{
+		if (commands_context.sdu->config->usbp->state == USB_ACTIVE)
+		{
+			thread_t *shell = chThdCreateStatic(area_shell_thread,
+			                                    sizeof(area_shell_thread),
+			                                    NORMALPRIO,
+			                                    shellThread,
+			                                    &commands_context.shell_config);
+			chThdWait(shell);
+			(void)chEvtGetAndClearEvents(EVENT_MASK(0));
+		}
+		else
+		{
+			(void)chEvtWaitAny(EVENT_MASK(0));
+		}
+		(void)chEvtGetAndClearFlags(&listener);
+	}
+}
+
+void commands_set_boot_light(uint32_t usec)
+{
+	commands_context.boot_light_usec = usec;
+}
+
+void commands_set_boot_usb(uint32_t msec)
+{
+	commands_context.boot_usb_msec = msec;
+}
+
+void commands_initialize(SerialUSBDriver *sdu)
+{
+	commands_context.sdu = sdu;
+	commands_context.shell_config.sc_channel = (BaseSequentialStream *)sdu;
+	commands_context.shell_config.sc_commands = commands_list;
+	shellInit();
+
+	chThdCreateStatic(area_commands_thread,
+	                  sizeof(area_commands_thread),
+	                  NORMALPRIO,
+	                  commands_thread,
+	                  NULL);
+}
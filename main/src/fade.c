@@ -0,0 +1,257 @@
+#include <hal.h>
+#include "ch.h"
+#include "fade.h"
+#include "pwm.h"
+#include "config.h"
+
+#if !defined(FADE_DMA_IRQ_PRIORITY) || !defined(FADE_DURATION_MAX_MSEC)
+#error Fade engine is not configured!
+#endif
+
+#define FADE_PWM              PWMD3                        /** Timer of pwm.c, channels 0.. */
+#define FADE_CHANNELS         PWM_DMA_CHANNELS
+#define FADE_DCR_CCR1         13u                          /** Offset of CCR1 in timer registers, words, for DMA burst. */
+#define FADE_DMA_STREAM       STM32_DMA_STREAM_ID(1, 3)    /** TIM3_UP request is on DMA1 channel 3. */
+#define FADE_POSITION_SHIFT   40u                          /** Level is Q40 fixed point while fading. */
+#define FADE_PERIODS_PER_SEC  (PWM_FREQUENCY / PWM_PERIOD)
+#define FADE_STEPS_PER_SEC    400u                         /** Curve is advanced at 400 Hz with any PWM frequency. */
+#define FADE_STEP_PERIODS     (FADE_PERIODS_PER_SEC / FADE_STEPS_PER_SEC)
+#define FADE_STEPS_MAX        (FADE_DURATION_MAX_MSEC * FADE_STEPS_PER_SEC / 1000u)
+#define FADE_VELOCITY_MAX     ((int64_t)PWM_LEVEL_MAX << FADE_POSITION_SHIFT) /** Per step, keeps tangents in 64 bits. */
+#if FADE_STEP_PERIODS == 1u
+#define FADE_BUFFER_SIZE      64u                          /** Compare values of 64 PWM periods, 160 ms. */
+#else
+#define FADE_BUFFER_SIZE      256u                         /** Interrupt per 64 ms at 2 kHz, per 6.4 ms at 20 kHz. */
+#endif
+#define FADE_HALF_SIZE        (FADE_BUFFER_SIZE / 2u)
+#define FADE_GAIN_SHIFT       16u
+
+#if FADE_STEP_PERIODS * FADE_STEPS_PER_SEC != FADE_PERIODS_PER_SEC
+#error PWM frequency is not a multiple of fade step rate!
+#endif
+
+/*
+ * Fade engine.
+ * DMA writes compare values of channels 0..FADE_CHANNELS-1 on every timer update, from circular buffer of compare values.
+ * Timer DMA burst sends all channels of one period by one update request, through DMAR register.
+ * One half of buffer is filled by interrupt while the other one is being sent,
+ * so CPU prepares FADE_HALF_SIZE periods at once: ramp step and sigma-delta dithering of each period.
+ * Prepared half is sent after the other one, so fade is done two interrupts after its last period is prepared.
+ *
+ * Fade is cubic Hermite curve from current level and velocity to target level and end velocity of easing.
+ * Curve is evaluated by forward differences: three additions per step, divisions are done once per fade.
+ * With high PWM frequency curve is stepped once per FADE_STEP_PERIODS periods, so rounding error of forward differences
+ * doesn't grow with the number of periods; level of each period is still dithered.
+ * Fade started during another one begins with velocity of that one, so brightness changes smoothly.
+ * Channels share the level, compare value of each channel is scaled by its gain and dithered separately.
+ * Back aligned channels (PWM_DMA_BACK_CHANNELS) get compare value PWM_PERIOD - duty, see phase staggering in pwm.c.
+ * Fade and gains may be set before DMA is started, so the first PWM periods after boot are already lit.
+ *
+ * At target level periods get steady pattern of pwm_pattern() instead, it repeats every FADE_BUFFER_SIZE periods.
+ * When both halves are filled with it, circular DMA repeats the buffer without CPU,
+ * so its interrupts are disabled till fade_to() or fade_set_gains(): no wakeups while lamp is dark or steady.
+ */
+static struct
+{
+	const stm32_dma_stream_t *dma;
+	uint16_t                  buffer[FADE_BUFFER_SIZE][FADE_CHANNELS]; /** Compare values of next PWM periods. */
+	int64_t                   position;                    /** Level of last prepared period, Q40. */
+	int64_t                   velocity;                    /** Level change to next step, first difference. */
+	int64_t                   acceleration;                /** Second difference. */
+	int64_t                   jerk;                        /** Third difference, constant for cubic curve. */
+	uint32_t                  steps;                       /** Curve steps to target level. */
+	uint32_t                  step_periods;                /** Periods left in current step. */
+	uint16_t                  target;                      /** Target level. */
+	uint8_t                   done_countdown;              /** Interrupts before target level is sent. */
+	uint8_t                   steady_halves;               /** Halves filled at target level since the last change. */
+	bool                      quiet;                       /** Buffer is repeated, DMA interrupts are disabled. */
+	uint32_t                  gains[FADE_CHANNELS];        /** Gains of channels, Q16. */
+	int32_t                   errors[FADE_CHANNELS];       /** Errors of sigma-delta dithering. */
+	event_source_t            event;
+}fade_context =
+{
+	.gains = { [0 ... FADE_CHANNELS - 1] = FADE_GAIN_ONE },
+};
+
+/* Curve with velocities may overshoot, level is limited. */
+static uint16_t fade_position_level(int64_t position)
+{
+	if (position <= 0) { return 0; }
+	position >>= FADE_POSITION_SHIFT;
+	return (position > PWM_LEVEL_MAX) ? PWM_LEVEL_MAX : (uint16_t)position;
+}
+
+static void fade_fill(uint32_t half)
+{
+	uint16_t (*buffer)[FADE_CHANNELS] = &fade_context.buffer[half * FADE_HALF_SIZE];
+	uint32_t i;
+	uint32_t channel;
+
+	if (fade_context.steps > 0)
+	{
+		fade_context.steady_halves = 0;
+	}
+	else if (fade_context.steady_halves < 2)
+	{
+		fade_context.steady_halves++;
+	}
+
+	for (i = 0; i < FADE_HALF_SIZE; i++)
+	{
+		if (fade_context.step_periods > 1)
+		{
+			fade_context.step_periods--;
+		}
+		else if (fade_context.steps > 0)
+		{
+			fade_context.step_periods = FADE_STEP_PERIODS;
+			fade_context.steps--;
+			fade_context.position += fade_context.velocity;
+			fade_context.velocity += fade_context.acceleration;
+			fade_context.acceleration += fade_context.jerk;
+			if (fade_context.steps == 0)
+			{
+				fade_context.position = (int64_t)fade_context.target << FADE_POSITION_SHIFT;
+				fade_context.velocity = 0;
+				fade_context.acceleration = 0;
+				fade_context.jerk = 0;
+				fade_context.done_countdown = 2;
+			}
+		}
+		const uint32_t ticks = pwm_level_ticks(fade_position_level(fade_context.position));
+		for (channel = 0; channel < FADE_CHANNELS; channel++)
+		{
+			const uint32_t scaled = (uint32_t)(((uint64_t)ticks * fade_context.gains[channel]) >> FADE_GAIN_SHIFT);
+			const uint16_t duty = (fade_context.steps > 0) ? pwm_quantize(&fade_context.errors[channel], scaled) :
+			                      pwm_pattern(scaled, half * FADE_HALF_SIZE + i, FADE_BUFFER_SIZE);
+			buffer[i][channel] = (PWM_DMA_BACK_CHANNELS & (1U << channel)) ? (uint16_t)(PWM_PERIOD - duty) : duty;
+		}
+	}
+}
+
+/* Called within critical zone, when the buffer is going to change. */
+static void fade_wakeup(void)
+{
+	fade_context.steady_halves = 0;
+	if (fade_context.quiet)
+	{
+		/* Flags of halves sent meanwhile are stale, the next one tells which half is free. */
+		fade_context.quiet = false;
+		dmaStreamClearInterrupt(fade_context.dma);
+		fade_context.dma->channel->CCR |= STM32_DMA_CR_HTIE | STM32_DMA_CR_TCIE;
+	}
+}
+
+static void fade_dma_interrupt(void *context, uint32_t flags)
+{
+	(void)context;
+
+	if ((flags & (STM32_DMA_ISR_HTIF | STM32_DMA_ISR_TCIF)) == 0)
+	{
+		return;
+	}
+
+	if (fade_context.done_countdown > 0)
+	{
+		if (--fade_context.done_countdown == 0)
+		{
+			chSysLockFromISR();
+			chEvtBroadcastFlagsI(&fade_context.event, FADE_EVENT_DONE);
+			chSysUnlockFromISR();
+		}
+	}
+
+	/* Half transfer means the first half is sent and is free now. */
+	fade_fill((flags & STM32_DMA_ISR_TCIF) ? 1u : 0u);
+	if ((fade_context.steady_halves == 2) && (fade_context.done_countdown == 0))
+	{
+		fade_context.quiet = true;
+		fade_context.dma->channel->CCR &= ~(STM32_DMA_CR_HTIE | STM32_DMA_CR_TCIE);
+	}
+}
+
+void fade_initialize(void)
+{
+	chEvtObjectInit(&fade_context.event);
+	fade_fill(0);
+	fade_fill(1);
+
+	fade_context.dma = dmaStreamAlloc(FADE_DMA_STREAM, FADE_DMA_IRQ_PRIORITY, fade_dma_interrupt, NULL);
+	chDbgAssert(fade_context.dma != NULL, "DMA channel is busy");
+	dmaStreamSetPeripheral(fade_context.dma, &FADE_PWM.tim->DMAR);
+	dmaStreamSetMemory0(fade_context.dma, fade_context.buffer);
+	dmaStreamSetTransactionSize(fade_context.dma, FADE_BUFFER_SIZE * FADE_CHANNELS);
+	dmaStreamSetMode(fade_context.dma, STM32_DMA_CR_PL(2) | STM32_DMA_CR_DIR_M2P | STM32_DMA_CR_MINC | STM32_DMA_CR_CIRC |
+	                                   STM32_DMA_CR_PSIZE_HWORD | STM32_DMA_CR_MSIZE_HWORD | STM32_DMA_CR_HTIE | STM32_DMA_CR_TCIE);
+	dmaStreamEnable(fade_context.dma);
+	FADE_PWM.tim->DCR = STM32_TIM_DCR_DBA(FADE_DCR_CCR1) | STM32_TIM_DCR_DBL(FADE_CHANNELS - 1u);
+	FADE_PWM.tim->DIER |= STM32_TIM_DIER_UDE;
+}
+
+void fade_to(uint16_t level, uint32_t duration_msec, fade_curve_t curve)
+{
+	int64_t n = (int64_t)duration_msec * FADE_STEPS_PER_SEC / 1000;
+	int64_t p0;
+	int64_t p1;
+	int64_t delta;
+	int64_t m0;
+	int64_t m1;
+	int64_t a;
+	int64_t b;
+
+	if (level > PWM_LEVEL_MAX) { level = PWM_LEVEL_MAX; }
+	if (n < 1) { n = 1; }
+	if (n > FADE_STEPS_MAX) { n = FADE_STEPS_MAX; }
+	p1 = (int64_t)level << FADE_POSITION_SHIFT;
+
+	chSysLock();
+	p0 = fade_context.position;
+	delta = p1 - p0;
+
+	/* Tangents are level changes per whole fade: velocity per step multiplied by number of steps. */
+	switch (curve)
+	{
+		default:
+		case FADE_LINEAR:      m0 = delta;     m1 = delta;     break;
+		case FADE_EASE_IN:     m0 = 0;         m1 = 2 * delta; break;
+		case FADE_EASE_OUT:    m0 = 2 * delta; m1 = 0;         break;
+		case FADE_EASE_IN_OUT: m0 = 0;         m1 = 0;         break;
+	}
+	if (fade_context.steps > 0)
+	{
+		int64_t velocity = fade_context.velocity;
+		if (velocity > FADE_VELOCITY_MAX) { velocity = FADE_VELOCITY_MAX; }
+		if (velocity < -FADE_VELOCITY_MAX) { velocity = -FADE_VELOCITY_MAX; }
+		m0 = velocity * n;
+	}
+
+	/* p(k) = a k^3 + b k^2 + c k + p0, c = m0 / n, and its forward differences at k = 0. */
+	a = (2 * p0 - 2 * p1 + m0 + m1) / (n * n * n);
+	b = (3 * p1 - 3 * p0 - 2 * m0 - m1) / (n * n);
+	fade_context.velocity = a + b + m0 / n;
+	fade_context.acceleration = 6 * a + 2 * b;
+	fade_context.jerk = 6 * a;
+	fade_context.target = level;
+	fade_context.steps = (uint32_t)n;
+	fade_context.done_countdown = 0;
+	fade_wakeup();
+	chSysUnlock();
+}
+
+void fade_set_gains(const uint32_t *gains)
+{
+	uint32_t channel;
+
+	chSysLock();
+	for (channel = 0; channel < FADE_CHANNELS; channel++)
+	{
+		fade_context.gains[channel] = (gains[channel] > FADE_GAIN_ONE) ? FADE_GAIN_ONE : gains[channel];
+	}
+	fade_wakeup();
+	chSysUnlock();
+}
+
+event_source_t *fade_event_source(void)
+{
+	return &fade_context.event;
+}
@@ -0,0 +1,45 @@
+#include "ch.h"
+#include "idle.h"
+
+/*
+ * Idle time measurement.
+ * Kernel calls idle_enter() and idle_leave() from idle hooks of chconf.h, within critical zone,
+ * when idle thread is switched in and out. Time is measured by DWT cycle counter of realtime counter,
+ * interrupts served without switch of thread are counted as idle time.
+ * Idle loop hook follows every WFI exit, so idle_loop() counts interrupts which woke MCU,
+ * also the ones served without switch of thread (DMA of fade engine, timers).
+ */
+static struct
+{
+	rtcnt_t enter_cycles;                   /** Cycle counter when idle thread was entered. */
+	uint64_t idle_cycles;
+	uint32_t wakeups;
+	uint32_t switches;
+}idle_context;
+
+void idle_enter(void)
+{
+	idle_context.enter_cycles = chSysGetRealtimeCounterX();
+}
+
+void idle_leave(void)
+{
+	idle_context.idle_cycles += (rtcnt_t)(chSysGetRealtimeCounterX() - idle_context.enter_cycles);
+	idle_context.switches++;
+}
+
+/* Called by idle thread only, with interrupts enabled. */
+void idle_loop(void)
+{
+	idle_context.wakeups++;
+}
+
+void idle_get_statistics(idle_statistics_t *statistics)
+{
+	chSysLock();
+	statistics->cycles = chSysGetRealtimeCounterX();
+	statistics->idle_cycles = idle_context.idle_cycles;
+	statistics->wakeups = idle_context.wakeups;
+	statistics->switches = idle_context.switches;
+	chSysUnlock();
+}
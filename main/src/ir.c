@@ -1,5 +1,8 @@
 #include <hal.h>
+#include "ch.h"
 #include "ir.h"
+#include "ir_protocol.h"
+#include "ring.h"
 #include "config.h"
 
 #if !defined(IR_PORT) || !defined(IR_PIN)
@@ -14,23 +17,42 @@
 #error Infrared receiver requires TIM1.
 #endif
 
-#define IR_NUMBER_OF_BITS_PER_COMMAND   96      /** Number of measurements per command, not including synchronization. */
-#define IR_BITMAP_RECEIVED_SIZE         12      /** Number of bytes for bitmap. */
-#define IR_MEASURES_PER_BIT   3u                /** Measures per bit, depends on tick time. Maximum 32. */
-
-#define IR_REPEAT_TIMEOUT                                       120u /** How long we will waiting for repeat. */
-#define IR_TIMER_10_MSEC                                      40000u /** 10 milliseconds. */
-#define IR_SYNC_LEADING_PULSE_MAX_TICKS                       40000u /** Maximum timer ticks of first part of synchronisation. */
-#define IR_SYNC_LEADING_PULSE_MIN_TICKS                       32000u /** Minimum timer ticks of first part of synchronisation. */
-#define IR_SYNC_SPACE_LEADING_SPACE_MAX_TICKS                 20000u /** Maximum timer ticks of second part of synchronisation. */
-#define IR_SYNC_SPACE_LEADING_SPACE_MIN_TICKS                 16000u /** Minimum timer ticks of second part of synchronisation. */
+#if !defined(IR_STORM_EDGES_MAX) || !defined(IR_STORM_QUIET_MSEC)
+#error Infrared interrupt storm protection is not configured!
+#endif
 
-#define IR_REPEAT_PAUSE_MIN_TIME                                 90u /** Time between repeat codes. */
-#define IR_REPEAT_LEADING_PULSE_MAX_TICKS                     40000u /** Maximum timer ticks of first part of repeating. */
-#define IR_REPEAT_LEADING_PULSE_MIN_TICKS                     32000u /** Minimum timer ticks of first part of repeating. */
-#define IR_REPEAT_SPACE_LEADING_SPACE_MAX_TICKS               10000u /** Maximum timer ticks of second part of repeating. */
-#define IR_REPEAT_SPACE_LEADING_SPACE_MIN_TICKS                8000u /** Minimum timer ticks of second part of repeating. */
+#if (IR_USE_NEC != TRUE) && (IR_USE_RC5 != TRUE) && (IR_USE_RC6 != TRUE) && (IR_USE_SIRC != TRUE) && (IR_USE_SAMSUNG32 != TRUE)
+#error No infrared protocol is enabled!
+#endif
 
+#define IR_EDGE_RING_SIZE               64u     /** Number of signal changes waiting for decoding, power of two. */
+#define IR_EDGE_PULSE                   0x80000000u  /** Edge flag: pulse begins at this edge. */
+#define IR_DECODER_PRIORITY             (NORMALPRIO - 1) /** Decoder thread priority. */
+#define IR_EVENT_QUEUE_SIZE             16u     /** Number of received commands waiting for application. */
+#define IR_TIMER_10_MSEC                40000u  /** 10 milliseconds. */
+#define IR_QUIET_USEC                   150000u /** Longer than any frame and gap between repeats. */
+#define IR_STAMP_PERIODS                100u    /** Kernel time stamp is refreshed once per second, 16 bit system time wraps in 4 s. */
+#define IR_STAMP_QUIET_MSEC             4000u   /** Kernel time stamp refresh while timer is stopped, within wrap of system time. */
+
+/** Decoders of enabled protocols, all of them are fed with every signal change. */
+static const ir_decoder_t ir_decoders[] =
+{
+#if IR_USE_NEC == TRUE
+	{IR_PROTOCOL_NEC, ir_nec_decode},
+#endif
+#if IR_USE_RC5 == TRUE
+	{IR_PROTOCOL_RC5, ir_rc5_decode},
+#endif
+#if IR_USE_RC6 == TRUE
+	{IR_PROTOCOL_RC6, ir_rc6_decode},
+#endif
+#if IR_USE_SIRC == TRUE
+	{IR_PROTOCOL_SIRC, ir_sirc_decode},
+#endif
+#if IR_USE_SAMSUNG32 == TRUE
+	{IR_PROTOCOL_SAMSUNG32, ir_samsung_decode},
+#endif
+};
 
 static struct
 {
@@ -40,460 +62,332 @@ static struct
 	{
 		ir_command_callback_t  *callback;                                           /** Callback for received commands. */
 		void                                *callback_context;                      /** Context for callback. */
-		uint8_t                             received_bits[IR_BITMAP_RECEIVED_SIZE]; /** Array for measurement results. */
-		uint16_t                            last_address;                           /** Last received address. */
-		uint8_t                             last_command;                           /** Last received command. */
-		bool                                command_received;                       /** True if we received command. */
+		ir_frame_callback_t    *frame_callback;                                     /** Callback for received commands with protocol. */
+		void                                *frame_callback_context;                /** Context for frame callback. */
 	}decoder;
 	struct
 	{
-		uint32_t              ticks_measurement_shift;        /** Time from signal change to measurement. */
-		uint32_t              ticks_per_measurement;          /** Tick from one measurement to next one. */
-		bool                  rearm_timer;                    /** Flag means that measurements synchronizing with signal change. */
-		uint8_t               bits_received;                  /** Number of received bits. */
-		uint8_t               bit_measure_num;                /** Current number of measure, per bit. */
-		uint32_t              bit_measures;                   /** Measures per bit. */
-		uint32_t              time_since_last_command_msec;   /** Time since last command received, milliseconds. */
-	}measurements;
-	enum
+		objects_fifo_t        fifo;                           /** Queue of received commands. */
+		ir_event_t            buffer[IR_EVENT_QUEUE_SIZE];    /** Storage of queued commands. */
+		msg_t                 messages[IR_EVENT_QUEUE_SIZE];  /** Storage of queue mailbox. */
+		bool                  enabled;                        /** Commands are queued. */
+	}events;
+	struct
 	{
-		IR_SYNC_WAIT_SIGNAL_RISE = 0,      /** Waiting for first rise signal. */
-		IR_SYNC_WAIT_SIGNAL_FALL,          /** Signal risen and now waiting for falling it. */
-		IR_SYNC_WAIT_SIGNAL_RISE_END,      /** Signal risen and fallen and now waiting for second rise. */
-		IR_SYNC_DONE,                      /** Signal risen second time. It's mean synchro impulse was and now data is receiving. */
-	}sync_state;
-	enum
+		uint32_t              buffer[IR_EDGE_RING_SIZE];      /** Timestamps of signal changes with IR_EDGE_PULSE flag. */
+		ring_t                ring;                           /** Ring indexes, filled by interrupt and drained by decoder thread. */
+		uint32_t              dropped;                        /** Number of signal changes lost because ring was full. */
+		binary_semaphore_t    ready;                          /** Signaled when there are signal changes to decode. */
+	}edges;
+	ir_statistics_t           statistics;                /** Decoding counters, written by decoder thread only. */
+	struct
 	{
-		IR_REPEAT_WAIT_SIGNAL_RISE = 0,      /** Waiting for first rise signal. */
-		IR_REPEAT_WAIT_SIGNAL_FALL,          /** Signal risen and now waiting for falling it. */
-		IR_REPEAT_WAIT_SIGNAL_RISE_END,      /** Signal risen and fallen and now waiting for second rise. */
-		IR_REPEAT_FAULT,                     /** Repeat fault. */
-	}repeat_state;
-	enum
+		uint32_t              edges;                          /** Signal changes in current 10 milliseconds. */
+		uint32_t              quiet_msec;                     /** Time of quiet signal while receiver is disabled. */
+		uint32_t              episodes;                       /** Number of times receiver was disabled. */
+		bool                  active;                         /** Receiver is disabled by storm. */
+		bool                  last_value;                     /** Signal level at previous check while receiver is disabled. */
+	}storm;
+	struct
 	{
-		IR_STATE_SYNCHRONIZATION = 0,      /** Wait for start. */
-		IR_STATE_RECEIVE_COMMAND,          /** Command receiving in progress. */
-		IR_STATE_WAIT_REPEAT,              /** Waiting for repeat command. */
-	}state;
-
+		uint32_t              time_base;                      /** Timestamp of last timer overflow, ticks. */
+		uint32_t              last_edge_time;                 /** Timestamp of previous signal change, ticks. */
+		uint32_t              wakeup_delay;                   /** Delay of the next edge interrupt by wakeup from STOP, ticks. */
+		uint32_t              stamp_periods;                  /** Timer overflows since kernel time stamp was refreshed. */
+		systimestamp_t        stop_stamp;                     /** Kernel time stamp when timer was stopped. */
+		virtual_timer_t       stamp_timer;                    /** Refreshes kernel time stamp while timer is stopped. */
+		bool                  stopped;                        /** Timer is stopped while signal is quiet. */
+	}measurements;
 
 }ir_context;
 
+static THD_WORKING_AREA(area_ir_decoder_thread, 256);
 
-static bool ir_bitmap_value_get(uint8_t bit_number)
+
+static void ir_report_frame(const ir_frame_t *frame)
 {
-	if (bit_number >= IR_NUMBER_OF_BITS_PER_COMMAND)
+	if (ir_context.decoder.callback)
 	{
-		return false;
+		ir_context.decoder.callback(ir_context.decoder.callback_context, frame->address, frame->command, frame->repeat);
 	}
-	return (ir_context.decoder.received_bits[bit_number / 8] & (1 << (bit_number % 8))) != 0;
-}
-
-static void ir_bitmap_value_set(uint8_t bit_number, bool bit_value)
-{
-	if (bit_value)
+	if (ir_context.decoder.frame_callback)
 	{
-		(ir_context.decoder.received_bits[bit_number / 8] |= (1 << (bit_number % 8)));
+		ir_context.decoder.frame_callback(ir_context.decoder.frame_callback_context,
+		                                  frame->protocol, frame->address, frame->command, frame->repeat);
 	}
-	else
+	if (ir_context.events.enabled)
 	{
-		(ir_context.decoder.received_bits[bit_number / 8] &= ~(1 << (bit_number % 8)));
+		ir_event_t *event = chFifoTakeObjectTimeout(&ir_context.events.fifo, TIME_IMMEDIATE);
+		if (event == NULL)
+		{
+			ir_context.statistics.lost_events++;
+			return;
+		}
+		event->protocol = frame->protocol;
+		event->address = frame->address;
+		event->command = frame->command;
+		event->repeat = frame->repeat;
+		event->time = chVTGetTimeStamp();
+		chFifoSendObject(&ir_context.events.fifo, event);
 	}
 }
 
-static bool ir_bit_decode(uint8_t from_bit_number, bool *value)
+static bool ir_pad_value(void)
 {
-	const bool bit_1 = ir_bitmap_value_get(from_bit_number);
-	const bool bit_2 = ir_bitmap_value_get(from_bit_number + 1);
-	if (!bit_1 || bit_2)
-	{
-		/* Bit 1 must be "1" and bit 2 must be "0". */
-		return false;
-	}
+#if IR_PIN_INVERTED == TRUE
+	return palReadPad(IR_PORT, IR_PIN) == PAL_LOW;
+#else
+	return palReadPad(IR_PORT, IR_PIN) == PAL_HIGH;
+#endif
+}
 
-	const bool bit_3 = ir_bitmap_value_get(from_bit_number + 2);
-	if (bit_3)
-	{
-		/* if bit 3 is "1" - it is next value and our value is logic zero. */
-		*value = false;
-		return true;
-	}
-	/* if bit 3 and 4 is "0" - our value is logic one. */
-	const bool bit_4 = ir_bitmap_value_get(from_bit_number + 3);
-	if (bit_4)
+static uint32_t ir_timestamp(void)
+{
+	uint32_t time_base = ir_context.measurements.time_base;
+	uint32_t counter = gptGetCounterX(ir_context.gpt);
+
+	if (((ir_context.gpt->tim->SR & STM32_TIM_SR_UIF) != 0) && (counter < IR_TIMER_10_MSEC / 2))
 	{
-		return false;
+		/* Counter overflowed, but overflow interrupt is not served yet. */
+		time_base += IR_TIMER_10_MSEC;
 	}
-	*value = true;
-	return true;
+	return time_base + counter;
 }
 
-static bool ir_byte_decode(uint8_t *from_bit_number, uint8_t *value)
+static void ir_decode_edge(uint32_t edge)
 {
+	const uint32_t now = edge & IR_EDGE_TIME_MASK;
+	const uint32_t duration = ir_elapsed(now, ir_context.measurements.last_edge_time);
+	/* Signal changed, so duration belongs to the previous level. */
+	const bool pulse = (edge & IR_EDGE_PULSE) == 0;
+	const rtcnt_t start = chSysGetRealtimeCounterX();
+	rtcnt_t cycles;
 	uint8_t i;
-	bool bit_conversion_result;
-	bool bit_value;
-	uint8_t result = 0;
 
-	for (i = 0; i < 8; i++)
+	ir_context.measurements.last_edge_time = now;
+
+	for (i = 0; i < sizeof(ir_decoders) / sizeof(ir_decoders[0]); i++)
 	{
-		bit_conversion_result = ir_bit_decode(*from_bit_number, &bit_value);
-		if (!bit_conversion_result)
+		ir_frame_t frame;
+		if (ir_decoders[i].decode(pulse, duration, now, &frame))
 		{
-			return false;
+			frame.protocol = ir_decoders[i].protocol;
+			ir_context.statistics.frames[frame.protocol]++;
+			ir_report_frame(&frame);
 		}
+	}
 
-		result >>= 1;
-		if (bit_value)
-		{
-			result |= 0x80;
-			*from_bit_number += 4;
-		}
-		else
-		{
-			*from_bit_number += 2;
-		}
+	/* Cost of callbacks is included, it is paid by decoder thread too. */
+	cycles = chSysGetRealtimeCounterX() - start;
+	ir_context.statistics.edges++;
+	ir_context.statistics.decode_cycles_total += cycles;
+	if (cycles > ir_context.statistics.decode_cycles_max)
+	{
+		ir_context.statistics.decode_cycles_max = cycles;
 	}
-	*value = result;
-	return true;
 }
 
-static bool ir_word_decode(uint8_t *from_bit_number, uint16_t *value)
+static THD_FUNCTION(ir_decoder_thread, arg)
 {
-	union
-	{
-		struct
-		{
-			uint8_t b1;
-			uint8_t b2;
-		};
-		uint16_t w;
-	}result;
+	(void)arg;
+	chRegSetThreadName("ir_decoder");
 
-	if (!ir_byte_decode(from_bit_number, &result.b1))
+	while (true)
 	{
-		return false;
-	}
-
-	if (!ir_byte_decode(from_bit_number, &result.b2))
-	{
-		return false;
+		chBSemWait(&ir_context.edges.ready);
+		while (!ring_is_empty(&ir_context.edges.ring))
+		{
+			const uint32_t edge = ir_context.edges.buffer[ring_tail_index(&ir_context.edges.ring, IR_EDGE_RING_SIZE)];
+			ring_pop(&ir_context.edges.ring);
+			ir_decode_edge(edge);
+		}
 	}
+}
 
-	*value = result.w;
+/*
+ * Signal changes are limited to IR_STORM_EDGES_MAX per 10 milliseconds, more ones disable receiver.
+ * So worst case of interrupt load is IR_STORM_EDGES_MAX + 1 edge interrupts and one timer interrupt
+ * per 10 milliseconds, and decoder thread never gets more signal changes than that.
+ * Receiver is enabled again when signal is quiet for IR_STORM_QUIET_MSEC,
+ * signal is checked by timer every 10 milliseconds meanwhile.
+ */
+static void ir_pad_interrupt (void*context);
 
-	return true;
+static void ir_storm_begin(void)
+{
+	chSysLockFromISR();
+	palDisablePadEventI(IR_PORT, IR_PIN);
+	chSysUnlockFromISR();
+	ir_context.storm.active = true;
+	ir_context.storm.quiet_msec = 0;
+	ir_context.storm.last_value = ir_pad_value();
+	ir_context.storm.episodes++;
 }
 
-static void ir_decode_command(void)
+static void ir_storm_check(void)
 {
-	uint8_t bit_index = 0;
-	uint16_t address = 0;
-	uint8_t command = 0;
-	uint8_t i_command = 0;
+	const bool value = ir_pad_value();
 
-	ir_word_decode(&bit_index, &address);
-	ir_byte_decode(&bit_index, &command);
-	ir_byte_decode(&bit_index, &i_command);
-
-	if ((command + i_command) != 0xff)
+	if (value || (value != ir_context.storm.last_value))
 	{
-		return;
+		ir_context.storm.quiet_msec = 0;
 	}
-
-	if (ir_context.decoder.callback)
+	else
 	{
-		ir_context.decoder.command_received = true;
-		ir_context.decoder.last_address = address;
-		ir_context.decoder.last_command = command;
-		ir_context.decoder.callback(ir_context.decoder.callback_context, address, command, false);
+		ir_context.storm.quiet_msec += 10;
 	}
-}
+	ir_context.storm.last_value = value;
 
-static void ir_push_signal_value(bool value, uint8_t bit_number)
-{
-	ir_bitmap_value_set(bit_number, value);
-	if (bit_number == IR_NUMBER_OF_BITS_PER_COMMAND - 1)
+	if (ir_context.storm.quiet_msec >= IR_STORM_QUIET_MSEC)
 	{
-		/* Last bit received. */
-		ir_decode_command();
+		ir_context.storm.active = false;
+		chSysLockFromISR();
+		palSetPadCallbackI(IR_PORT, IR_PIN, ir_pad_interrupt, NULL);
+		palEnablePadEventI(IR_PORT, IR_PIN, PAL_EVENT_MODE_FALLING_EDGE | PAL_EVENT_MODE_RISING_EDGE);
+		chSysUnlockFromISR();
 	}
 }
 
-static void ir_synchronize_receiving (void)
+/*
+ * Quiet receiver stops timer, so idle MCU is not woken up every 10 milliseconds.
+ * The next edge starts it again and time since stop is taken from kernel time stamp,
+ * which is refreshed by virtual timer meanwhile, once per wrap of system time.
+ */
+static void ir_stamp_callback(virtual_timer_t *vtp, void *p)
 {
-	gptStopTimerI(ir_context.gpt);
-	gptStartOneShotI(ir_context.gpt, ir_context.measurements.ticks_measurement_shift);
-	ir_context.measurements.rearm_timer = true;
+	(void)p;
+	chSysLockFromISR();
+	(void)chVTGetTimeStampI();
+	chVTSetI(vtp, TIME_MS2I(IR_STAMP_QUIET_MSEC), ir_stamp_callback, NULL);
+	chSysUnlockFromISR();
 }
 
-static bool ir_pad_value(void)
+/* Edge interrupt must not come between the check and the stop, or its edge would wait for the next one. */
+static void ir_timer_stop_if_quiet(void)
 {
-#if IR_PIN_INVERTED == TRUE
-	return palReadPad(IR_PORT, IR_PIN) == PAL_LOW;
-#elif
-	return palReadPad(IR_PORT, IR_PIN) == PAL_HIGH;
-#endif
-}
-
-static void ir_reset_state(void)
-{
-	gptStopTimerI(ir_context.gpt);
-	ir_context.decoder.command_received = false;
-	ir_context.decoder.last_address = 0;
-	ir_context.decoder.last_command = 0;
-	ir_context.measurements.bit_measures = 0;
-	ir_context.measurements.bit_measure_num = 0;
-	ir_context.measurements.bits_received = 0;
-	ir_context.measurements.time_since_last_command_msec = 0;
-	ir_context.state = IR_STATE_SYNCHRONIZATION;
-	ir_context.sync_state = IR_SYNC_WAIT_SIGNAL_RISE;
-	ir_context.repeat_state = IR_REPEAT_WAIT_SIGNAL_RISE;
-}
-
-static bool ir_waiting_timeout(void)
-{
-	return ir_context.measurements.time_since_last_command_msec > IR_REPEAT_TIMEOUT;
-}
-
-static void ir_synchronization(void)
-{
-	switch (ir_context.sync_state)
+	chSysLockFromISR();
+	if (ring_is_empty(&ir_context.edges.ring) &&
+	    (ir_elapsed(ir_context.measurements.time_base, ir_context.measurements.last_edge_time) >= IR_USEC(IR_QUIET_USEC)))
 	{
-		case IR_SYNC_WAIT_SIGNAL_RISE:
-			if (ir_pad_value())
-			{
-				gptStopTimerI(ir_context.gpt);
-				gptStartOneShot(ir_context.gpt, IR_SYNC_LEADING_PULSE_MAX_TICKS);
-				ir_context.sync_state = IR_SYNC_WAIT_SIGNAL_FALL;
-			}
-			return;
-		case IR_SYNC_WAIT_SIGNAL_FALL:
-			if (!ir_pad_value())
-			{
-				uint32_t impulse_ticks = gptGetCounterX(ir_context.gpt);
-				if (impulse_ticks > IR_SYNC_LEADING_PULSE_MIN_TICKS)
-				{
-					/* First impulse is 16 normal impulses. Each impulse measures 3 times with time shift 1/2 measure time. */
-					ir_context.measurements.ticks_per_measurement = impulse_ticks / 16 / 3;
-					ir_context.measurements.ticks_measurement_shift = ir_context.measurements.ticks_per_measurement / 2;
-					/* Now, measure space. */
-					ir_context.sync_state = IR_SYNC_WAIT_SIGNAL_RISE_END;
-					gptStopTimerI(ir_context.gpt);
-					gptStartOneShot(ir_context.gpt, IR_SYNC_SPACE_LEADING_SPACE_MAX_TICKS);
-				}
-				else
-				{
-					ir_reset_state();
-				}
-			}
-			return;
-		case IR_SYNC_WAIT_SIGNAL_RISE_END:
-			if (ir_pad_value())
-			{
-				uint32_t space_time = gptGetCounterX(ir_context.gpt);
-				if (space_time > IR_SYNC_SPACE_LEADING_SPACE_MIN_TICKS)
-				{
-					ir_context.sync_state = IR_SYNC_DONE;
-					ir_context.state = IR_STATE_RECEIVE_COMMAND;
-					ir_synchronize_receiving();
-				}
-				else
-				{
-					ir_reset_state();
-				}
-			}
-			return;
-		case IR_SYNC_DONE:
-			return;
+		gptStopTimerI(ir_context.gpt);
+		ir_context.measurements.stop_stamp = chVTGetTimeStampI();
+		chVTSetI(&ir_context.measurements.stamp_timer, TIME_MS2I(IR_STAMP_QUIET_MSEC), ir_stamp_callback, NULL);
+		ir_context.measurements.stopped = true;
 	}
+	chSysUnlockFromISR();
 }
 
-static void ir_receiving(void)
+static void ir_timer_restart(void)
 {
-	if (ir_waiting_timeout())
-	{
-		ir_reset_state();
-	}
-
-	switch (ir_context.repeat_state)
-	{
-		case IR_REPEAT_WAIT_SIGNAL_RISE:
-			if (ir_pad_value())
-			{
-				if (ir_context.measurements.time_since_last_command_msec < IR_REPEAT_PAUSE_MIN_TIME)
-				{
-					ir_context.repeat_state = IR_REPEAT_WAIT_SIGNAL_RISE_END;
-					gptStopTimerI(ir_context.gpt);
-					gptStartOneShot(ir_context.gpt, IR_REPEAT_SPACE_LEADING_SPACE_MAX_TICKS);
-				}
-				gptStopTimerI(ir_context.gpt);
-				gptStartOneShot(ir_context.gpt, IR_REPEAT_LEADING_PULSE_MAX_TICKS);
-				ir_context.repeat_state = IR_REPEAT_WAIT_SIGNAL_FALL;
-			}
-			return;
-		case IR_REPEAT_WAIT_SIGNAL_FALL:
-			if (!ir_pad_value())
-			{
-				uint32_t impulse_ticks = gptGetCounterX(ir_context.gpt);
-				if (impulse_ticks > IR_REPEAT_LEADING_PULSE_MIN_TICKS)
-				{
-					ir_context.repeat_state = IR_REPEAT_WAIT_SIGNAL_RISE_END;
-					gptStopTimerI(ir_context.gpt);
-					gptStartOneShot(ir_context.gpt, IR_REPEAT_SPACE_LEADING_SPACE_MAX_TICKS);
-				}
-				else
-				{
-					gptStopTimerI(ir_context.gpt);
-					gptStartContinuousI(ir_context.gpt, IR_TIMER_10_MSEC);
-					ir_context.repeat_state = IR_REPEAT_FAULT;
-				}
-			}
-			return;
-		case IR_REPEAT_WAIT_SIGNAL_RISE_END:
-			if (ir_pad_value())
-			{
-				uint32_t space_time = gptGetCounterX(ir_context.gpt);
-				if (space_time > IR_REPEAT_SPACE_LEADING_SPACE_MIN_TICKS)
-				{
-					if (ir_context.decoder.callback)
-					{
-						ir_context.decoder.callback(ir_context.decoder.callback_context,
-						                                         ir_context.decoder.last_address,
-						                                         ir_context.decoder.last_command,
-						                                         true);
-						ir_context.measurements.time_since_last_command_msec = 0;
-						ir_context.repeat_state = IR_REPEAT_WAIT_SIGNAL_RISE;
-						gptStopTimerI(ir_context.gpt);
-						gptStartContinuousI(ir_context.gpt, IR_TIMER_10_MSEC);
-					}
-				}
-				else
-				{
-					gptStopTimerI(ir_context.gpt);
-					gptStartContinuousI(ir_context.gpt, IR_TIMER_10_MSEC);
-					ir_context.repeat_state = IR_REPEAT_FAULT;
-				}
-			}
-			return;
-		case IR_REPEAT_FAULT:
-			/* Do not do anything, just waiting for timeout. */
-			return;
-	}
+	systimestamp_t stopped_ticks;
+
+	chSysLockFromISR();
+	chVTResetI(&ir_context.measurements.stamp_timer);
+	stopped_ticks = chVTGetTimeStampI() - ir_context.measurements.stop_stamp;
+	gptStartContinuousI(ir_context.gpt, IR_TIMER_10_MSEC);
+	chSysUnlockFromISR();
+	ir_context.measurements.stopped = false;
+	ir_context.measurements.stamp_periods = 0;
+	ir_context.measurements.time_base += (uint32_t)(stopped_ticks * IR_USEC(1000000u) / CH_CFG_ST_FREQUENCY);
 }
 
 static void ir_pad_interrupt (void*context)
 {
 	(void)context;
+	uint32_t edge;
 
-	switch (ir_context.state)
+	if (ir_context.measurements.stopped)
 	{
-		case IR_STATE_SYNCHRONIZATION:
-			ir_synchronization();
-			break;
-		case IR_STATE_RECEIVE_COMMAND:
-			if (ir_pad_value())
-			{
-				ir_synchronize_receiving();
-			}
-			break;
-		case IR_STATE_WAIT_REPEAT:
-			ir_receiving();
-			break;
+		ir_timer_restart();
 	}
+	edge = (ir_timestamp() - ir_context.measurements.wakeup_delay) & IR_EDGE_TIME_MASK;
 
-}
+	ir_context.measurements.wakeup_delay = 0;
 
-static void ir_receive_command (void)
-{
-	ir_context.measurements.bit_measures <<= 1;
+	if (++ir_context.storm.edges > IR_STORM_EDGES_MAX)
+	{
+		ir_storm_begin();
+		return;
+	}
 
 	if (ir_pad_value())
 	{
-		ir_context.measurements.bit_measures |= 1;
+		edge |= IR_EDGE_PULSE;
 	}
-	ir_context.measurements.bit_measure_num++;
 
-	if (ir_context.measurements.bit_measure_num == IR_MEASURES_PER_BIT)
+	if (ring_is_full(&ir_context.edges.ring, IR_EDGE_RING_SIZE))
 	{
-		/* All measures done, calculate effective value and push bit to higher level. */
-		uint8_t one_values = 0;
-		while(ir_context.measurements.bit_measures)
-		{
-			if (ir_context.measurements.bit_measures & 1)
-			{
-				one_values++;
-			}
-			ir_context.measurements.bit_measures >>= 1;
-		}
-		bool effective_value = one_values == (IR_MEASURES_PER_BIT);
-
-		ir_push_signal_value(effective_value, ir_context.measurements.bits_received);
-
-		ir_context.measurements.bit_measures = 0;
-		ir_context.measurements.bit_measure_num = 0;
-		ir_context.measurements.bits_received++;
-
+		ir_context.edges.dropped++;
+		return;
 	}
+	ir_context.edges.buffer[ring_head_index(&ir_context.edges.ring, IR_EDGE_RING_SIZE)] = edge;
+	ring_push(&ir_context.edges.ring);
 }
 
 static void ir_timer_callback(GPTDriver *gptp)
 {
 	(void)gptp;
-	if (ir_context.measurements.rearm_timer)
+	ir_context.measurements.time_base += IR_TIMER_10_MSEC;
+	ir_context.storm.edges = 0;
+
+	/*
+	 * Time stamps of events extend system time, which wraps in a few seconds,
+	 * so kernel must see every wrap. Timer is stopped together with system time in STOP mode.
+	 */
+	if (++ir_context.measurements.stamp_periods >= IR_STAMP_PERIODS)
 	{
-		ir_context.measurements.rearm_timer = false;
-		gptStopTimerI(ir_context.gpt);
-		gptStartContinuousI(ir_context.gpt, ir_context.measurements.ticks_per_measurement);
+		ir_context.measurements.stamp_periods = 0;
+		chSysLockFromISR();
+		(void)chVTGetTimeStampI();
+		chSysUnlockFromISR();
 	}
-	switch (ir_context.state)
+	if (ir_context.storm.active)
+	{
+		ir_storm_check();
+	}
+
+	/* Decoder is woken up by timer, so edge interrupt stays as short as possible. */
+	if (!ring_is_empty(&ir_context.edges.ring))
 	{
-		case IR_STATE_SYNCHRONIZATION:
-			break;
-		case IR_STATE_RECEIVE_COMMAND:
-			if (ir_context.measurements.bits_received == IR_NUMBER_OF_BITS_PER_COMMAND)
-			{
-				if (!ir_context.decoder.command_received)
-				{
-					ir_reset_state();
-				}
-				else
-				{
-					ir_context.state = IR_STATE_WAIT_REPEAT;
-					gptStopTimerI(ir_context.gpt);
-					gptStartContinuousI(ir_context.gpt, IR_TIMER_10_MSEC);
-					/* Command longer than repeat, so correct start time. */
-					ir_context.measurements.time_since_last_command_msec = 50;
-				}
-				break;
-			}
-			ir_receive_command();
-			break;
-		case IR_STATE_WAIT_REPEAT:
-			ir_context.measurements.time_since_last_command_msec += 10;
-			if (ir_waiting_timeout())
-			{
-				ir_reset_state();
-			}
-			break;
+		chSysLockFromISR();
+		chBSemSignalI(&ir_context.edges.ready);
+		chSysUnlockFromISR();
+	}
+	else if (!ir_context.storm.active)
+	{
+		ir_timer_stop_if_quiet();
 	}
 }
 
 void ir_initialize(void)
 {
-	/* Setup infrared receiver pin. */
-	palSetPadMode(IR_PORT, IR_PIN, PAL_MODE_INPUT_PULLUP);
-	palSetPadCallback(IR_PORT, IR_PIN, ir_pad_interrupt, NULL);
-	palEnablePadEvent(IR_PORT, IR_PIN, PAL_EVENT_MODE_FALLING_EDGE | PAL_EVENT_MODE_RISING_EDGE);
-
-	/* Setup timers. */
+	chFifoObjectInit(&ir_context.events.fifo,
+	                 sizeof(ir_event_t),
+	                 IR_EVENT_QUEUE_SIZE,
+	                 ir_context.events.buffer,
+	                 ir_context.events.messages);
+	chBSemObjectInit(&ir_context.edges.ready, true);
+	chThdCreateStatic(area_ir_decoder_thread,
+	                  sizeof(area_ir_decoder_thread),
+	                  IR_DECODER_PRIORITY,
+	                  ir_decoder_thread,
+	                  NULL);
+
+	/* Setup timers. Timer runs till signal is quiet, signal changes are timestamped by its counter. */
 	{
 		ir_context.gpt = &GPTD1;
 		/* 4MhZ 0.25 usec per tick. */
 		ir_context.gpt_config.frequency = 4000000;
 		ir_context.gpt_config.callback = ir_timer_callback;
+		chVTObjectInit(&ir_context.measurements.stamp_timer);
 		gptStart(ir_context.gpt, &ir_context.gpt_config);
+		gptStartContinuous(ir_context.gpt, IR_TIMER_10_MSEC);
 	}
+
+	/* Setup infrared receiver pin. */
+	palSetPadMode(IR_PORT, IR_PIN, PAL_MODE_INPUT_PULLUP);
+	palSetPadCallback(IR_PORT, IR_PIN, ir_pad_interrupt, NULL);
+	palEnablePadEvent(IR_PORT, IR_PIN, PAL_EVENT_MODE_FALLING_EDGE | PAL_EVENT_MODE_RISING_EDGE);
 }
 
 void ir_set_callback(ir_command_callback_t *callback, void *context)
@@ -501,3 +395,59 @@ void ir_set_callback(ir_command_callback_t *callback, void *context)
 	ir_context.decoder.callback = callback;
 	ir_context.decoder.callback_context = context;
 }
+
+void ir_set_frame_callback(ir_frame_callback_t *callback, void *context)
+{
+	ir_context.decoder.frame_callback = callback;
+	ir_context.decoder.frame_callback_context = context;
+}
+
+void ir_enable_events(void)
+{
+	ir_context.events.enabled = true;
+}
+
+bool ir_event_get(ir_event_t *event, sysinterval_t timeout)
+{
+	ir_event_t *queued;
+
+	if (chFifoReceiveObjectTimeout(&ir_context.events.fifo, (void **)&queued, timeout) != MSG_OK)
+	{
+		return false;
+	}
+	*event = *queued;
+	chFifoReturnObject(&ir_context.events.fifo, queued);
+	return true;
+}
+
+/*
+ * Timer is stopped in STOP mode and clocks are restarted before the edge interrupt is served,
+ * so the first edge is timestamped late and the first pulse would be too short for decoders.
+ */
+void ir_wakeup(uint32_t delay_usec)
+{
+	ir_context.measurements.wakeup_delay = IR_USEC(delay_usec);
+}
+
+bool ir_is_quiet(void)
+{
+	return ring_is_empty(&ir_context.edges.ring) && !ir_context.storm.active &&
+	       (ir_elapsed(ir_timestamp(), ir_context.measurements.last_edge_time) >= IR_USEC(IR_QUIET_USEC));
+}
+
+uint32_t ir_dropped_edges(void)
+{
+	return ir_context.edges.dropped;
+}
+
+uint32_t ir_lost_events(void)
+{
+	return ir_context.statistics.lost_events;
+}
+
+void ir_get_statistics(ir_statistics_t *statistics)
+{
+	*statistics = ir_context.statistics;
+	statistics->dropped_edges = ir_context.edges.dropped;
+	statistics->storms = ir_context.storm.episodes;
+}
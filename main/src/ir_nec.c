@@ -0,0 +1,131 @@
+#include <hal.h>
+#include "ir_protocol.h"
+#include "config.h"
+
+#if IR_USE_NEC == TRUE
+
+#define IR_NEC_BITS_PER_COMMAND         32u          /** Number of data bits per command, not including synchronization. */
+#define IR_NEC_COMMAND_CHECK_MASK       0x00ff0000u  /** Command bits of frame after xor with inverted command. */
+
+#define IR_NEC_REPEAT_TIMEOUT           120u    /** How long we will waiting for repeat, milliseconds. */
+#define IR_NEC_LEADING_PULSE_USEC       9000u   /** Leading pulse, 16 bit periods. */
+
+static struct
+{
+	ir_pulse_distance_t   data;                 /** Data bits receiving. */
+	uint32_t              leading_pulse_ticks;  /** Duration of last leading pulse, it is time reference of remote. */
+	uint32_t              last_command_time;    /** Timestamp of end of last command or repeat, ticks. */
+	uint16_t              last_address;         /** Last received address. */
+	uint8_t               last_command;         /** Last received command. */
+	bool                  command_received;     /** True if we received command, so repeat is possible. */
+	enum
+	{
+		IR_NEC_STATE_SYNCHRONIZATION = 0,      /** Wait for leading pulse. */
+		IR_NEC_STATE_SYNC_SPACE,               /** Leading pulse received, waiting for end of leading space. */
+		IR_NEC_STATE_RECEIVE_COMMAND,          /** Command receiving in progress. */
+	}state;
+}ir_nec_context;
+
+static void ir_nec_synchronization(bool pulse, uint32_t duration)
+{
+	ir_nec_context.state = IR_NEC_STATE_SYNCHRONIZATION;
+	if (pulse && ir_in_range(duration, IR_MIN_TICKS(IR_NEC_LEADING_PULSE_USEC), IR_MAX_TICKS(IR_NEC_LEADING_PULSE_USEC)))
+	{
+		/* First impulse is 16 normal impulses. */
+		ir_nec_context.leading_pulse_ticks = duration;
+		ir_pulse_distance_start(&ir_nec_context.data, duration >> 4);
+		ir_nec_context.state = IR_NEC_STATE_SYNC_SPACE;
+	}
+}
+
+/** Nominal duration, measured by clock of remote, is accepted with 1/4 tolerance. */
+static bool ir_nec_in_range(uint32_t duration, uint32_t nominal)
+{
+	return ir_in_range(duration, nominal - (nominal >> 2), nominal + (nominal >> 2));
+}
+
+static bool ir_nec_sync_space(bool pulse, uint32_t duration, uint32_t now, ir_frame_t *frame)
+{
+	ir_nec_context.state = IR_NEC_STATE_SYNCHRONIZATION;
+	if (pulse)
+	{
+		return false;
+	}
+
+	/* Leading space is 8 bit periods. */
+	if (ir_nec_in_range(duration, ir_nec_context.leading_pulse_ticks >> 1))
+	{
+		/* Now data is receiving. */
+		ir_nec_context.state = IR_NEC_STATE_RECEIVE_COMMAND;
+		return false;
+	}
+
+	/* Repeat space is 4 bit periods. */
+	if (ir_nec_in_range(duration, ir_nec_context.leading_pulse_ticks >> 2))
+	{
+		/* Repeat code. */
+		const uint32_t pulse_start_time = now - duration - ir_nec_context.leading_pulse_ticks;
+		if (ir_nec_context.command_received &&
+		    (ir_elapsed(pulse_start_time, ir_nec_context.last_command_time) < IR_NEC_REPEAT_TIMEOUT * IR_TICKS_PER_MSEC))
+		{
+			ir_nec_context.last_command_time = now;
+			frame->address = ir_nec_context.last_address;
+			frame->command = ir_nec_context.last_command;
+			frame->repeat = true;
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool ir_nec_receive_command(bool pulse, uint32_t duration, uint32_t now, ir_frame_t *frame)
+{
+	if (!ir_pulse_distance_push(&ir_nec_context.data, pulse, duration))
+	{
+		/* Broken frame, but this pulse may be beginning of new one. */
+		ir_nec_synchronization(pulse, duration);
+		return false;
+	}
+
+	if (!pulse || (ir_nec_context.data.bits_received != IR_NEC_BITS_PER_COMMAND))
+	{
+		return false;
+	}
+
+	/* Pulse after last data space finishes command. */
+	ir_nec_context.state = IR_NEC_STATE_SYNCHRONIZATION;
+	ir_nec_context.command_received = false;
+
+	/* Command is followed by its inversion, so xor of them must be all ones. */
+	const uint32_t data = ir_nec_context.data.frame;
+	if (((data ^ (data >> 8)) & IR_NEC_COMMAND_CHECK_MASK) != IR_NEC_COMMAND_CHECK_MASK)
+	{
+		return false;
+	}
+
+	ir_nec_context.command_received = true;
+	ir_nec_context.last_command_time = now;
+	ir_nec_context.last_address = (uint16_t)data;
+	ir_nec_context.last_command = (uint8_t)(data >> 16);
+	frame->address = ir_nec_context.last_address;
+	frame->command = ir_nec_context.last_command;
+	frame->repeat = false;
+	return true;
+}
+
+bool ir_nec_decode(bool pulse, uint32_t duration, uint32_t now, ir_frame_t *frame)
+{
+	switch (ir_nec_context.state)
+	{
+		case IR_NEC_STATE_SYNCHRONIZATION:
+			ir_nec_synchronization(pulse, duration);
+			return false;
+		case IR_NEC_STATE_SYNC_SPACE:
+			return ir_nec_sync_space(pulse, duration, now, frame);
+		case IR_NEC_STATE_RECEIVE_COMMAND:
+			return ir_nec_receive_command(pulse, duration, now, frame);
+	}
+	return false;
+}
+
+#endif /* IR_USE_NEC */
@@ -0,0 +1,118 @@
+#include <hal.h>
+#include "ir_protocol.h"
+#include "config.h"
+
+#if IR_USE_RC5 == TRUE
+
+#define IR_RC5_UNIT_TICKS         IR_USEC(889u)  /** Half of bit. */
+#define IR_RC5_UNITS_PER_COMMAND  28u            /** 14 bits: 2 start bits, toggle, 5 bits of address and 6 bits of command. */
+#define IR_RC5_IDLE_UNITS         3u             /** Space longer than this is gap between frames. */
+#define IR_RC5_REPEAT_TIMEOUT     150u           /** Same toggle in this time after previous command is repeat, milliseconds. */
+
+#define IR_RC5_BIT_START          0u             /** Index of first start bit. */
+#define IR_RC5_BIT_FIELD          1u             /** Second start bit, inverted 7th bit of command. */
+#define IR_RC5_BIT_TOGGLE         2u             /** Toggle bit, changes on every key press. */
+#define IR_RC5_BIT_ADDRESS        3u             /** First bit of address, most significant. */
+#define IR_RC5_ADDRESS_BITS       5u             /** Bits of address. */
+#define IR_RC5_BIT_COMMAND        8u             /** First bit of command, most significant. */
+#define IR_RC5_COMMAND_BITS       6u             /** Bits of command. */
+#define IR_RC5_BITS_PER_COMMAND   14u            /** Bits of frame. */
+
+static struct
+{
+	ir_units_t            units;                /** Received half bits. */
+	uint32_t              frame_start_time;     /** Timestamp of first pulse of frame. */
+	uint32_t              last_command_time;    /** Timestamp of end of last command, ticks. */
+	uint16_t              last_data;            /** Last received frame, including toggle bit. */
+	bool                  idle;                 /** Gap between frames was received, next pulse starts frame. */
+	bool                  receiving;            /** Frame receiving in progress. */
+}ir_rc5_context;
+
+static bool ir_rc5_decode_command(uint32_t now, ir_frame_t *frame)
+{
+	uint16_t data = 0;
+	uint8_t i;
+
+	/* Bit value is level of its second half. */
+	for (i = 0; i < IR_RC5_BITS_PER_COMMAND; i++)
+	{
+		const int bit = ir_units_bit(&ir_rc5_context.units, i * 2u, 1);
+		if (bit < 0)
+		{
+			return false;
+		}
+		data = (data << 1) | (uint16_t)bit;
+	}
+
+	if ((data & (1u << (IR_RC5_BITS_PER_COMMAND - 1u - IR_RC5_BIT_START))) == 0)
+	{
+		return false;
+	}
+
+	frame->repeat = (data == ir_rc5_context.last_data) &&
+	                (ir_elapsed(ir_rc5_context.frame_start_time, ir_rc5_context.last_command_time) <
+	                 IR_RC5_REPEAT_TIMEOUT * IR_TICKS_PER_MSEC);
+	frame->address = (data >> IR_RC5_COMMAND_BITS) & ((1u << IR_RC5_ADDRESS_BITS) - 1u);
+	frame->command = data & ((1u << IR_RC5_COMMAND_BITS) - 1u);
+	if ((data & (1u << (IR_RC5_BITS_PER_COMMAND - 1u - IR_RC5_BIT_FIELD))) == 0)
+	{
+		/* Extended RC5, field bit is inverted 7th bit of command. */
+		frame->command |= 1u << IR_RC5_COMMAND_BITS;
+	}
+	ir_rc5_context.last_data = data;
+	ir_rc5_context.last_command_time = now;
+	return true;
+}
+
+bool ir_rc5_decode(bool pulse, uint32_t duration, uint32_t now, ir_frame_t *frame)
+{
+	const uint8_t units = ir_units_count(duration, IR_RC5_UNIT_TICKS, 2);
+
+	if (!ir_rc5_context.receiving)
+	{
+		if (!pulse)
+		{
+			ir_rc5_context.idle = duration > IR_RC5_UNIT_TICKS * IR_RC5_IDLE_UNITS;
+			return false;
+		}
+		if (!ir_rc5_context.idle || (units == 0))
+		{
+			return false;
+		}
+		/* First half of first start bit is space, merged with gap. */
+		ir_rc5_context.idle = false;
+		ir_rc5_context.receiving = true;
+		ir_rc5_context.frame_start_time = now - duration;
+		ir_rc5_context.units.levels = 0;
+		ir_rc5_context.units.count = 0;
+		ir_units_push(&ir_rc5_context.units, false, 1);
+	}
+
+	if (units == 0)
+	{
+		ir_rc5_context.receiving = false;
+		ir_rc5_context.idle = !pulse && (duration > IR_RC5_UNIT_TICKS * IR_RC5_IDLE_UNITS);
+		return false;
+	}
+	ir_units_push(&ir_rc5_context.units, pulse, units);
+
+	if (pulse && (ir_rc5_context.units.count == IR_RC5_UNITS_PER_COMMAND - 1u))
+	{
+		/* Last bit is zero, its second half is space, merged with gap. */
+		ir_units_push(&ir_rc5_context.units, false, 1);
+	}
+
+	if (ir_rc5_context.units.count < IR_RC5_UNITS_PER_COMMAND)
+	{
+		return false;
+	}
+
+	ir_rc5_context.receiving = false;
+	if (!pulse || (ir_rc5_context.units.count != IR_RC5_UNITS_PER_COMMAND))
+	{
+		return false;
+	}
+	return ir_rc5_decode_command(now, frame);
+}
+
+#endif /* IR_USE_RC5 */
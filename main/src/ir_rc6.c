@@ -0,0 +1,149 @@
+#include <hal.h>
+#include "ir_protocol.h"
+#include "config.h"
+
+#if IR_USE_RC6 == TRUE
+
+#define IR_RC6_UNIT_TICKS         IR_USEC(444u)  /** Half of normal bit. */
+#define IR_RC6_LEADING_PULSE_USEC 2666u          /** Leading pulse, 6 units. */
+#define IR_RC6_LEADING_SPACE_USEC 889u           /** Leading space, 2 units. */
+#define IR_RC6_UNITS_PER_COMMAND  44u            /** Start bit, 3 bits of mode, double toggle bit, 8 bits of address and 8 bits of command. */
+#define IR_RC6_REPEAT_TIMEOUT     150u           /** Same toggle in this time after previous command is repeat, milliseconds. */
+
+#define IR_RC6_UNIT_START         0u             /** First unit of start bit. */
+#define IR_RC6_UNIT_MODE          2u             /** First unit of mode, 3 bits. */
+#define IR_RC6_MODE_BITS          3u             /** Bits of mode. */
+#define IR_RC6_UNIT_TOGGLE        8u             /** First unit of toggle bit, it is twice as long as normal bit. */
+#define IR_RC6_UNIT_DATA          12u            /** First unit of address and command, most significant bit first. */
+#define IR_RC6_DATA_BITS          16u            /** Bits of address and command. */
+
+static struct
+{
+	ir_units_t            units;                /** Received half bits. */
+	uint32_t              frame_start_time;     /** Timestamp of beginning of leading pulse. */
+	uint32_t              last_command_time;    /** Timestamp of end of last command, ticks. */
+	uint32_t              last_data;            /** Last received data, including toggle bit. */
+	enum
+	{
+		IR_RC6_STATE_SYNCHRONIZATION = 0,      /** Wait for leading pulse. */
+		IR_RC6_STATE_SYNC_SPACE,               /** Leading pulse received, waiting for end of leading space. */
+		IR_RC6_STATE_RECEIVE_COMMAND,          /** Command receiving in progress. */
+	}state;
+}ir_rc6_context;
+
+/** Bit value is level of its first half, so it is inversion of second half. */
+static int ir_rc6_bit(uint8_t index, uint8_t width)
+{
+	const int bit = ir_units_bit(&ir_rc6_context.units, index, width);
+	return (bit < 0) ? bit : !bit;
+}
+
+static bool ir_rc6_decode_command(uint32_t now, ir_frame_t *frame)
+{
+	uint32_t data = 0;
+	uint8_t i;
+	int bit;
+
+	if (ir_rc6_bit(IR_RC6_UNIT_START, 1) != 1)
+	{
+		return false;
+	}
+	for (i = 0; i < IR_RC6_MODE_BITS; i++)
+	{
+		if (ir_rc6_bit(IR_RC6_UNIT_MODE + i * 2u, 1) != 0)
+		{
+			/* Only mode 0 is supported. */
+			return false;
+		}
+	}
+	bit = ir_rc6_bit(IR_RC6_UNIT_TOGGLE, 2);
+	if (bit < 0)
+	{
+		return false;
+	}
+	data = (uint32_t)bit;
+	for (i = 0; i < IR_RC6_DATA_BITS; i++)
+	{
+		bit = ir_rc6_bit(IR_RC6_UNIT_DATA + i * 2u, 1);
+		if (bit < 0)
+		{
+			return false;
+		}
+		data = (data << 1) | (uint32_t)bit;
+	}
+
+	frame->repeat = (data == ir_rc6_context.last_data) &&
+	                (ir_elapsed(ir_rc6_context.frame_start_time, ir_rc6_context.last_command_time) <
+	                 IR_RC6_REPEAT_TIMEOUT * IR_TICKS_PER_MSEC);
+	frame->address = (data >> 8) & 0xffu;
+	frame->command = data & 0xffu;
+	ir_rc6_context.last_data = data;
+	ir_rc6_context.last_command_time = now;
+	return true;
+}
+
+static void ir_rc6_synchronization(bool pulse, uint32_t duration, uint32_t now)
+{
+	ir_rc6_context.state = IR_RC6_STATE_SYNCHRONIZATION;
+	if (pulse && ir_in_range(duration, IR_MIN_TICKS(IR_RC6_LEADING_PULSE_USEC), IR_MAX_TICKS(IR_RC6_LEADING_PULSE_USEC)))
+	{
+		ir_rc6_context.frame_start_time = now - duration;
+		ir_rc6_context.state = IR_RC6_STATE_SYNC_SPACE;
+	}
+}
+
+static bool ir_rc6_receive_command(bool pulse, uint32_t duration, uint32_t now, ir_frame_t *frame)
+{
+	/* Toggle bit merged with neighbour half bit gives 3 units. */
+	const uint8_t units = ir_units_count(duration, IR_RC6_UNIT_TICKS, 3);
+
+	if (units == 0)
+	{
+		/* Broken frame, but this pulse may be beginning of new one. */
+		ir_rc6_synchronization(pulse, duration, now);
+		return false;
+	}
+	ir_units_push(&ir_rc6_context.units, pulse, units);
+
+	if (pulse && (ir_rc6_context.units.count == IR_RC6_UNITS_PER_COMMAND - 1u))
+	{
+		/* Last bit is one, its second half is space, merged with gap. */
+		ir_units_push(&ir_rc6_context.units, false, 1);
+	}
+
+	if (ir_rc6_context.units.count < IR_RC6_UNITS_PER_COMMAND)
+	{
+		return false;
+	}
+
+	ir_rc6_context.state = IR_RC6_STATE_SYNCHRONIZATION;
+	if (!pulse || (ir_rc6_context.units.count != IR_RC6_UNITS_PER_COMMAND))
+	{
+		return false;
+	}
+	return ir_rc6_decode_command(now, frame);
+}
+
+bool ir_rc6_decode(bool pulse, uint32_t duration, uint32_t now, ir_frame_t *frame)
+{
+	switch (ir_rc6_context.state)
+	{
+		case IR_RC6_STATE_SYNCHRONIZATION:
+			ir_rc6_synchronization(pulse, duration, now);
+			return false;
+		case IR_RC6_STATE_SYNC_SPACE:
+			ir_rc6_context.state = IR_RC6_STATE_SYNCHRONIZATION;
+			if (!pulse && ir_in_range(duration, IR_MIN_TICKS(IR_RC6_LEADING_SPACE_USEC), IR_MAX_TICKS(IR_RC6_LEADING_SPACE_USEC)))
+			{
+				ir_rc6_context.units.levels = 0;
+				ir_rc6_context.units.count = 0;
+				ir_rc6_context.state = IR_RC6_STATE_RECEIVE_COMMAND;
+			}
+			return false;
+		case IR_RC6_STATE_RECEIVE_COMMAND:
+			return ir_rc6_receive_command(pulse, duration, now, frame);
+	}
+	return false;
+}
+
+#endif /* IR_USE_RC6 */
@@ -0,0 +1,91 @@
+#include <hal.h>
+#include "ir_protocol.h"
+#include "config.h"
+
+#if IR_USE_SAMSUNG32 == TRUE
+
+#define IR_SAMSUNG_BITS_PER_COMMAND     32u          /** Number of data bits per command, not including synchronization. */
+#define IR_SAMSUNG_COMMAND_CHECK_MASK   0x00ff0000u  /** Command bits of frame after xor with inverted command. */
+#define IR_SAMSUNG_REPEAT_TIMEOUT       120u         /** Same command in this time after previous is repeat, milliseconds. */
+#define IR_SAMSUNG_LEADING_USEC         4500u        /** Leading pulse and leading space, 8 bit periods each. */
+
+static struct
+{
+	ir_pulse_distance_t   data;                 /** Data bits receiving. */
+	uint32_t              leading_start_time;   /** Timestamp of beginning of leading pulse. */
+	uint32_t              last_command_time;    /** Timestamp of end of last command, ticks. */
+	uint32_t              last_data;            /** Last received frame. */
+	enum
+	{
+		IR_SAMSUNG_STATE_SYNCHRONIZATION = 0,      /** Wait for leading pulse. */
+		IR_SAMSUNG_STATE_SYNC_SPACE,               /** Leading pulse received, waiting for end of leading space. */
+		IR_SAMSUNG_STATE_RECEIVE_COMMAND,          /** Command receiving in progress. */
+	}state;
+}ir_samsung_context;
+
+static void ir_samsung_synchronization(bool pulse, uint32_t duration, uint32_t now)
+{
+	ir_samsung_context.state = IR_SAMSUNG_STATE_SYNCHRONIZATION;
+	if (pulse && ir_in_range(duration, IR_MIN_TICKS(IR_SAMSUNG_LEADING_USEC), IR_MAX_TICKS(IR_SAMSUNG_LEADING_USEC)))
+	{
+		ir_samsung_context.leading_start_time = now - duration;
+		ir_pulse_distance_start(&ir_samsung_context.data, duration >> 3);
+		ir_samsung_context.state = IR_SAMSUNG_STATE_SYNC_SPACE;
+	}
+}
+
+static bool ir_samsung_receive_command(bool pulse, uint32_t duration, uint32_t now, ir_frame_t *frame)
+{
+	if (!ir_pulse_distance_push(&ir_samsung_context.data, pulse, duration))
+	{
+		/* Broken frame, but this pulse may be beginning of new one. */
+		ir_samsung_synchronization(pulse, duration, now);
+		return false;
+	}
+
+	if (!pulse || (ir_samsung_context.data.bits_received != IR_SAMSUNG_BITS_PER_COMMAND))
+	{
+		return false;
+	}
+
+	/* Pulse after last data space finishes command. */
+	ir_samsung_context.state = IR_SAMSUNG_STATE_SYNCHRONIZATION;
+
+	const uint32_t data = ir_samsung_context.data.frame;
+	if (((data ^ (data >> 8)) & IR_SAMSUNG_COMMAND_CHECK_MASK) != IR_SAMSUNG_COMMAND_CHECK_MASK)
+	{
+		return false;
+	}
+
+	/* Samsung remote repeats whole frame while key is holding. */
+	frame->repeat = (data == ir_samsung_context.last_data) &&
+	                (ir_elapsed(ir_samsung_context.leading_start_time, ir_samsung_context.last_command_time) <
+	                 IR_SAMSUNG_REPEAT_TIMEOUT * IR_TICKS_PER_MSEC);
+	frame->address = (uint16_t)data;
+	frame->command = (uint8_t)(data >> 16);
+	ir_samsung_context.last_data = data;
+	ir_samsung_context.last_command_time = now;
+	return true;
+}
+
+bool ir_samsung_decode(bool pulse, uint32_t duration, uint32_t now, ir_frame_t *frame)
+{
+	switch (ir_samsung_context.state)
+	{
+		case IR_SAMSUNG_STATE_SYNCHRONIZATION:
+			ir_samsung_synchronization(pulse, duration, now);
+			return false;
+		case IR_SAMSUNG_STATE_SYNC_SPACE:
+			ir_samsung_context.state = IR_SAMSUNG_STATE_SYNCHRONIZATION;
+			if (!pulse && ir_in_range(duration, IR_MIN_TICKS(IR_SAMSUNG_LEADING_USEC), IR_MAX_TICKS(IR_SAMSUNG_LEADING_USEC)))
+			{
+				ir_samsung_context.state = IR_SAMSUNG_STATE_RECEIVE_COMMAND;
+			}
+			return false;
+		case IR_SAMSUNG_STATE_RECEIVE_COMMAND:
+			return ir_samsung_receive_command(pulse, duration, now, frame);
+	}
+	return false;
+}
+
+#endif /* IR_USE_SAMSUNG32 */
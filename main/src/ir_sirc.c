@@ -0,0 +1,83 @@
+#include <hal.h>
+#include "ir_protocol.h"
+#include "config.h"
+
+#if IR_USE_SIRC == TRUE
+
+#define IR_SIRC_BITS_PER_COMMAND        12u     /** 7 bits of command and 5 bits of address. */
+#define IR_SIRC_REPEAT_TIMEOUT          60u     /** Same command in this time after previous is repeat, milliseconds. */
+#define IR_SIRC_LEADING_PULSE_USEC      2400u   /** Leading pulse. */
+#define IR_SIRC_ZERO_USEC               600u    /** Pulse of logic zero and every space. */
+#define IR_SIRC_ONE_USEC                1200u   /** Pulse of logic one. */
+
+static struct
+{
+	uint32_t              leading_start_time;   /** Timestamp of beginning of leading pulse. */
+	uint32_t              last_command_time;    /** Timestamp of end of last command, ticks. */
+	uint16_t              data;                 /** Received bits, first received bit is least significant. */
+	uint16_t              last_data;            /** Last received frame. */
+	uint8_t               bits_received;        /** Number of received data bits. */
+	bool                  receiving;            /** Leading pulse received, receiving data. */
+}ir_sirc_context;
+
+static void ir_sirc_synchronization(bool pulse, uint32_t duration, uint32_t now)
+{
+	ir_sirc_context.receiving = false;
+	if (pulse && ir_in_range(duration, IR_MIN_TICKS(IR_SIRC_LEADING_PULSE_USEC), IR_MAX_TICKS(IR_SIRC_LEADING_PULSE_USEC)))
+	{
+		ir_sirc_context.leading_start_time = now - duration;
+		ir_sirc_context.data = 0;
+		ir_sirc_context.bits_received = 0;
+		ir_sirc_context.receiving = true;
+	}
+}
+
+bool ir_sirc_decode(bool pulse, uint32_t duration, uint32_t now, ir_frame_t *frame)
+{
+	if (!ir_sirc_context.receiving)
+	{
+		ir_sirc_synchronization(pulse, duration, now);
+		return false;
+	}
+
+	if (!pulse)
+	{
+		if (!ir_in_range(duration, IR_MIN_TICKS(IR_SIRC_ZERO_USEC), IR_MAX_TICKS(IR_SIRC_ZERO_USEC)))
+		{
+			ir_sirc_context.receiving = false;
+		}
+		return false;
+	}
+
+	/* Pulse width coding, data is in pulses. */
+	if (!ir_in_range(duration, IR_MIN_TICKS(IR_SIRC_ZERO_USEC), IR_MAX_TICKS(IR_SIRC_ONE_USEC)))
+	{
+		/* Broken frame, but this pulse may be beginning of new one. */
+		ir_sirc_synchronization(pulse, duration, now);
+		return false;
+	}
+	ir_sirc_context.data >>= 1;
+	if (duration > IR_USEC((IR_SIRC_ZERO_USEC + IR_SIRC_ONE_USEC) / 2))
+	{
+		ir_sirc_context.data |= 1u << (IR_SIRC_BITS_PER_COMMAND - 1);
+	}
+	ir_sirc_context.bits_received++;
+
+	if (ir_sirc_context.bits_received != IR_SIRC_BITS_PER_COMMAND)
+	{
+		return false;
+	}
+
+	/* Last pulse finishes command, remote repeats whole frame while key is holding. */
+	ir_sirc_context.receiving = false;
+	frame->repeat = (ir_sirc_context.data == ir_sirc_context.last_data) &&
+	                (ir_elapsed(ir_sirc_context.leading_start_time, ir_sirc_context.last_command_time) <
+	                 IR_SIRC_REPEAT_TIMEOUT * IR_TICKS_PER_MSEC);
+	frame->command = ir_sirc_context.data & 0x7fu;
+	frame->address = ir_sirc_context.data >> 7;
+	ir_sirc_context.last_data = ir_sirc_context.data;
+	ir_sirc_context.last_command_time = now;
+	return true;
+}
+
+#endif /* IR_USE_SIRC */
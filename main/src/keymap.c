@@ -0,0 +1,302 @@
+#include <string.h>
+#include "ch.h"
+#include "keymap.h"
+#include "storage.h"
+#include "config.h"
+
+#if !defined(KEYMAP_FLASH_ADDRESS)
+#error Flash page of keymap is not configured!
+#endif
+
+#define KEYMAP_SLOTS_BITS     7u                   /** Twice more slots than bindings keeps probes short. */
+#define KEYMAP_SLOTS          (1u << KEYMAP_SLOTS_BITS)
+#define KEYMAP_SLOTS_MASK     (KEYMAP_SLOTS - 1u)
+#define KEYMAP_PROBES_MAX     8u                   /** Lookup compares at most so many slots. */
+#define KEYMAP_MAGIC          0x4B4D5031u          /** "KMP1", version of saved layout. */
+
+#if (KEYMAP_SLOTS < (2u * KEYMAP_ENTRIES_MAX))
+#error Keymap hash table is too small!
+#endif
+
+/** Saved keymap: header and packed bindings, slots are rebuilt on load. */
+typedef struct
+{
+	uint32_t magic;
+	uint32_t count;
+	uint32_t checksum;
+	keymap_entry_t entries[KEYMAP_ENTRIES_MAX];
+}keymap_image_t;
+
+static const keymap_entry_t keymap_defaults[] =
+{
+	{ 0x7f00, 0x53, KEYMAP_ACTION_OFF },
+	{ 0x7f00, 0x52, KEYMAP_ACTION_ON },
+	{ 0x7f00, 0x51, KEYMAP_ACTION_PLUS },
+	{ 0x7f00, 0x50, KEYMAP_ACTION_MINUS },
+	{ 0xff00, 0x06, KEYMAP_ACTION_OFF },
+	{ 0xff00, 0x07, KEYMAP_ACTION_ON },
+	{ 0xff00, 0x05, KEYMAP_ACTION_PLUS },
+	{ 0xff00, 0x04, KEYMAP_ACTION_MINUS },
+};
+
+static const char * const keymap_action_names[KEYMAP_ACTION_COUNT] =
+{
+	[KEYMAP_ACTION_NONE] = "none",
+	[KEYMAP_ACTION_OFF] = "off",
+	[KEYMAP_ACTION_ON] = "on",
+	[KEYMAP_ACTION_PLUS] = "plus",
+	[KEYMAP_ACTION_MINUS] = "minus",
+	[KEYMAP_ACTION_WARMER] = "warmer",
+	[KEYMAP_ACTION_COOLER] = "cooler",
+};
+
+/*
+ * Open addressing hash table with linear probing.
+ * Binding is never placed further than KEYMAP_PROBES_MAX slots from its hash slot,
+ * and removal shifts next bindings back, so lookup time doesn't depend on number of bindings.
+ */
+static struct
+{
+	mutex_t          lock;                      /** Lookup by remote thread, changes by shell. */
+	keymap_entry_t   slots[KEYMAP_SLOTS];
+	size_t           count;
+	keymap_image_t   image;                     /** Buffer for saving. */
+}keymap_context;
+
+static uint32_t keymap_hash(uint16_t address, uint8_t command)
+{
+	const uint32_t key = ((uint32_t)address << 8) | command;
+	return (key * 2654435761u) >> (32u - KEYMAP_SLOTS_BITS); /** Fibonacci hashing. */
+}
+
+static uint32_t keymap_checksum(const keymap_entry_t *entries, size_t count)
+{
+	uint32_t sum = KEYMAP_MAGIC;
+	size_t i;
+
+	for (i = 0; i < count; i++)
+	{
+		sum = (sum << 5) + (sum >> 27);
+		sum ^= ((uint32_t)entries[i].address << 16) | ((uint32_t)entries[i].command << 8) | entries[i].action;
+	}
+	return sum;
+}
+
+/* Slot of binding or free slot for it, or KEYMAP_SLOTS if there is no place. */
+static uint32_t keymap_find(uint16_t address, uint8_t command)
+{
+	uint32_t slot = keymap_hash(address, command);
+	uint32_t probe;
+
+	for (probe = 0; probe < KEYMAP_PROBES_MAX; probe++, slot = (slot + 1) & KEYMAP_SLOTS_MASK)
+	{
+		const keymap_entry_t *entry = &keymap_context.slots[slot];
+		if ((entry->action == KEYMAP_ACTION_NONE) || ((entry->address == address) && (entry->command == command)))
+		{
+			return slot;
+		}
+	}
+	return KEYMAP_SLOTS;
+}
+
+static bool keymap_insert(uint16_t address, uint8_t command, keymap_action_t action)
+{
+	const uint32_t slot = keymap_find(address, command);
+	keymap_entry_t *entry;
+
+	if (slot == KEYMAP_SLOTS)
+	{
+		return false;
+	}
+	entry = &keymap_context.slots[slot];
+	if (entry->action == KEYMAP_ACTION_NONE)
+	{
+		if (keymap_context.count >= KEYMAP_ENTRIES_MAX)
+		{
+			return false;
+		}
+		keymap_context.count++;
+	}
+	entry->address = address;
+	entry->command = command;
+	entry->action = (uint8_t)action;
+	return true;
+}
+
+static void keymap_remove(uint32_t slot)
+{
+	uint32_t next = slot;
+
+	keymap_context.slots[slot].action = KEYMAP_ACTION_NONE;
+	keymap_context.count--;
+
+	/* Shift back bindings of the same probe sequence, none of them moves away from its hash slot. */
+	while (true)
+	{
+		keymap_entry_t *entry;
+		uint32_t home;
+
+		next = (next + 1) & KEYMAP_SLOTS_MASK;
+		entry = &keymap_context.slots[next];
+		if (entry->action == KEYMAP_ACTION_NONE)
+		{
+			return;
+		}
+		home = keymap_hash(entry->address, entry->command);
+		if (((next - home) & KEYMAP_SLOTS_MASK) >= ((next - slot) & KEYMAP_SLOTS_MASK))
+		{
+			keymap_context.slots[slot] = *entry;
+			entry->action = KEYMAP_ACTION_NONE;
+			slot = next;
+		}
+	}
+}
+
+static void keymap_load(const keymap_entry_t *entries, size_t count)
+{
+	size_t i;
+
+	memset(keymap_context.slots, 0, sizeof(keymap_context.slots));
+	keymap_context.count = 0;
+	for (i = 0; i < count; i++)
+	{
+		if ((entries[i].action > KEYMAP_ACTION_NONE) && (entries[i].action < KEYMAP_ACTION_COUNT))
+		{
+			(void)keymap_insert(entries[i].address, entries[i].command, (keymap_action_t)entries[i].action);
+		}
+	}
+}
+
+static size_t keymap_copy(keymap_entry_t *entries, size_t size)
+{
+	size_t count = 0;
+	uint32_t slot;
+
+	for (slot = 0; (slot < KEYMAP_SLOTS) && (count < size); slot++)
+	{
+		if (keymap_context.slots[slot].action != KEYMAP_ACTION_NONE)
+		{
+			entries[count++] = keymap_context.slots[slot];
+		}
+	}
+	return count;
+}
+
+void keymap_initialize(void)
+{
+	const keymap_image_t *image = (const keymap_image_t *)storage_pointer(KEYMAP_FLASH_ADDRESS);
+
+	chMtxObjectInit(&keymap_context.lock);
+	if ((image->magic == KEYMAP_MAGIC)
+	 && (image->count <= KEYMAP_ENTRIES_MAX)
+	 && (image->checksum == keymap_checksum(image->entries, image->count)))
+	{
+		keymap_load(image->entries, image->count);
+	}
+	else
+	{
+		keymap_load(keymap_defaults, sizeof(keymap_defaults) / sizeof(keymap_defaults[0]));
+	}
+}
+
+keymap_action_t keymap_lookup(uint16_t address, uint8_t command)
+{
+	keymap_action_t action = KEYMAP_ACTION_NONE;
+	uint32_t slot;
+
+	chMtxLock(&keymap_context.lock);
+	slot = keymap_find(address, command);
+	if (slot != KEYMAP_SLOTS)
+	{
+		action = (keymap_action_t)keymap_context.slots[slot].action;
+	}
+	chMtxUnlock(&keymap_context.lock);
+	return action;
+}
+
+bool keymap_bind(uint16_t address, uint8_t command, keymap_action_t action)
+{
+	bool result;
+
+	if ((action <= KEYMAP_ACTION_NONE) || (action >= KEYMAP_ACTION_COUNT))
+	{
+		return keymap_unbind(address, command);
+	}
+	chMtxLock(&keymap_context.lock);
+	result = keymap_insert(address, command, action);
+	chMtxUnlock(&keymap_context.lock);
+	return result;
+}
+
+bool keymap_unbind(uint16_t address, uint8_t command)
+{
+	bool result = false;
+	uint32_t slot;
+
+	chMtxLock(&keymap_context.lock);
+	slot = keymap_find(address, command);
+	if ((slot != KEYMAP_SLOTS) && (keymap_context.slots[slot].action != KEYMAP_ACTION_NONE))
+	{
+		keymap_remove(slot);
+		result = true;
+	}
+	chMtxUnlock(&keymap_context.lock);
+	return result;
+}
+
+void keymap_reset(void)
+{
+	chMtxLock(&keymap_context.lock);
+	keymap_load(keymap_defaults, sizeof(keymap_defaults) / sizeof(keymap_defaults[0]));
+	chMtxUnlock(&keymap_context.lock);
+}
+
+bool keymap_save(void)
+{
+	keymap_image_t *image = &keymap_context.image;
+	size_t size;
+	bool result;
+
+	/* Image buffer is shared, the lock is held until it is written, so concurrent saves do not mix. */
+	chMtxLock(&keymap_context.lock);
+	image->magic = KEYMAP_MAGIC;
+	image->count = keymap_copy(image->entries, KEYMAP_ENTRIES_MAX);
+	image->checksum = keymap_checksum(image->entries, image->count);
+	size = offsetof(keymap_image_t, entries) + image->count * sizeof(keymap_entry_t);
+	result = storage_erase(KEYMAP_FLASH_ADDRESS) && storage_write(KEYMAP_FLASH_ADDRESS, image, size);
+	chMtxUnlock(&keymap_context.lock);
+	return result;
+}
+
+size_t keymap_get(keymap_entry_t *entries, size_t size)
+{
+	size_t count;
+
+	chMtxLock(&keymap_context.lock);
+	count = keymap_copy(entries, size);
+	chMtxUnlock(&keymap_context.lock);
+	return count;
+}
+
+const char *keymap_action_name(keymap_action_t action)
+{
+	if (action >= KEYMAP_ACTION_COUNT)
+	{
+		action = KEYMAP_ACTION_NONE;
+	}
+	return keymap_action_names[action];
+}
+
+keymap_action_t keymap_action_parse(const char *name)
+{
+	int action;
+
+	for (action = KEYMAP_ACTION_NONE + 1; action < KEYMAP_ACTION_COUNT; action++)
+	{
+		if (strcmp(name, keymap_action_names[action]) == 0)
+		{
+			return (keymap_action_t)action;
+		}
+	}
+	return KEYMAP_ACTION_NONE;
+}
@@ -0,0 +1,163 @@
+#include <string.h>
+#include "ch.h"
+#include "lamp.h"
+#include "storage.h"
+#include "config.h"
+
+#if !defined(LAMP_JOURNAL_ADDRESS)
+#error Lamp journal is not configured!
+#endif
+
+#define LAMP_JOURNAL_SLOTS    (STORAGE_PAGE_SIZE / sizeof(lamp_record_t))
+#define LAMP_RECORD_EMPTY     0xFFFFFFFFu  /** Word of erased flash. */
+
+/*
+ * Journal of saved brightness and CCT, records are appended to flash page and the last valid one is used.
+ * Page is erased only when it is full, so it wears once per 128 saves.
+ * Record interrupted by reset has wrong check and is skipped.
+ */
+typedef struct
+{
+	uint32_t value;                 /** Brightness in bits 0..7, CCT in bits 16..31. */
+	uint32_t check;                 /** Inverted value. */
+}lamp_record_t;
+
+/*
+ * Lamp state, changed by remote thread and shell, read by brightness smoothing thread.
+ * Writers are serialized by mutex, each one changes draft copy and publishes it by sequence lock:
+ * sequence is odd while published state is written. Readers copy state without locks
+ * and retry if sequence was odd or changed during the copy.
+ * Publishing is a critical zone of a few words, so threads never retry, only interrupts may.
+ */
+static struct
+{
+	mutex_t            writer;          /** Lock of writers, from lamp_begin() to lamp_commit(). */
+	lamp_state_t       draft;           /** State being changed by writer. */
+	volatile uint32_t  sequence;        /** Odd while state is written. */
+	lamp_state_t       state;           /** Published state. */
+	event_source_t     event;
+	uint32_t           journal_next;    /** Index of the first empty record, LAMP_JOURNAL_SLOTS if page is full. */
+	uint32_t           saved;           /** Value of the last valid record, LAMP_RECORD_EMPTY if none. */
+}lamp_context;
+
+static uint32_t lamp_record_value(const lamp_state_t *state)
+{
+	return (uint32_t)state->brightness | ((uint32_t)state->cct << 16);
+}
+
+/* Finds the last valid record and the slot after the last written one. */
+static void lamp_journal_scan(void)
+{
+	const lamp_record_t *journal = (const lamp_record_t *)storage_pointer(LAMP_JOURNAL_ADDRESS);
+	uint32_t slot;
+
+	lamp_context.saved = LAMP_RECORD_EMPTY;
+	lamp_context.journal_next = 0;
+	for (slot = 0; slot < LAMP_JOURNAL_SLOTS; slot++)
+	{
+		if ((journal[slot].value == LAMP_RECORD_EMPTY) && (journal[slot].check == LAMP_RECORD_EMPTY))
+		{
+			continue;
+		}
+		if (journal[slot].check == ~journal[slot].value)
+		{
+			lamp_context.saved = journal[slot].value;
+		}
+		lamp_context.journal_next = slot + 1;
+	}
+}
+
+void lamp_initialize(void)
+{
+	chMtxObjectInit(&lamp_context.writer);
+	chEvtObjectInit(&lamp_context.event);
+	lamp_journal_scan();
+}
+
+lamp_state_t *lamp_begin(void)
+{
+	chMtxLock(&lamp_context.writer);
+	return &lamp_context.draft;
+}
+
+void lamp_commit(void)
+{
+	const bool changed = memcmp(&lamp_context.draft, &lamp_context.state, sizeof(lamp_state_t)) != 0;
+
+	if (changed)
+	{
+		chSysLock();
+		lamp_context.sequence = lamp_context.sequence + 1;
+		__sync_synchronize(); /* Odd sequence must be visible before state is changed. */
+		lamp_context.state = lamp_context.draft;
+		__sync_synchronize(); /* State must be written before sequence is even again. */
+		lamp_context.sequence = lamp_context.sequence + 1;
+		chEvtBroadcastFlagsI(&lamp_context.event, LAMP_EVENT_CHANGED);
+		chSchRescheduleS();
+		chSysUnlock();
+	}
+	chMtxUnlock(&lamp_context.writer);
+}
+
+void lamp_get(lamp_state_t *state)
+{
+	uint32_t sequence;
+
+	do
+	{
+		sequence = lamp_context.sequence;
+		__sync_synchronize(); /* Sequence must be read before state. */
+		*state = lamp_context.state;
+		__sync_synchronize(); /* State must be read before sequence is checked. */
+	}
+	while ((sequence & 1U) || (sequence != lamp_context.sequence));
+}
+
+bool lamp_load(lamp_state_t *state)
+{
+	if (lamp_context.saved == LAMP_RECORD_EMPTY)
+	{
+		return false;
+	}
+	state->brightness = (uint8_t)lamp_context.saved;
+	state->cct = (uint16_t)(lamp_context.saved >> 16);
+	return true;
+}
+
+/* Called only by brightness smoothing thread, CPU stalls while flash is programmed. */
+bool lamp_save(void)
+{
+	lamp_state_t state;
+	lamp_record_t record;
+
+	lamp_get(&state);
+	record.value = lamp_record_value(&state);
+	if (record.value == lamp_context.saved)
+	{
+		return true;
+	}
+	record.check = ~record.value;
+
+	if (lamp_context.journal_next >= LAMP_JOURNAL_SLOTS)
+	{
+		if (!storage_erase(LAMP_JOURNAL_ADDRESS))
+		{
+			return false;
+		}
+		lamp_context.journal_next = 0;
+	}
+	/* Failed record has wrong check and is skipped, so the next save goes to the next slot. */
+	if (!storage_write(LAMP_JOURNAL_ADDRESS + lamp_context.journal_next * sizeof(lamp_record_t), &record, sizeof(record)))
+	{
+		lamp_context.journal_next++;
+		return false;
+	}
+	lamp_context.journal_next++;
+	lamp_context.saved = record.value;
+	return true;
+}
+
+event_source_t *lamp_event_source(void)
+{
+	return &lamp_context.event;
+}
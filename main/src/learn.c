@@ -0,0 +1,158 @@
+#include "ch.h"
+#include "learn.h"
+#include "keymap.h"
+#include "config.h"
+
+#if !defined(LEARN_FRAMES) || !defined(LEARN_COMBO_REPEATS) || !defined(LEARN_TIMEOUT_MSEC)
+#error Learning of remote keys is not configured!
+#endif
+
+#if COLOUR_TUNABLE_WHITE == TRUE
+#define LEARN_COMBO_END    KEYMAP_ACTION_COUNT          /** Action after the last learned one. */
+#else
+#define LEARN_COMBO_END    KEYMAP_ACTION_WARMER
+#endif
+
+/*
+ * Learning of remote keys.
+ * Key is learned after it is pressed LEARN_FRAMES times in a row, repeats of holding key are not counted.
+ * Learning is started by shell command, or by holding key of ON action for LEARN_COMBO_REPEATS repeats.
+ * Then keys for all actions are learned one by one: off, on, plus, minus (warmer, cooler with tunable white),
+ * and saved to flash.
+ * Key learning by remote is cancelled if no key is learned for LEARN_TIMEOUT_MSEC.
+ */
+static struct
+{
+	struct
+	{
+		uint16_t        address;
+		uint8_t         command;
+		uint8_t         frames;                 /** Number of presses of the same key. */
+	}key;
+	struct
+	{
+		bool            active;                 /** Waiting for key for shell. */
+		uint8_t         frames;                 /** Presses needed. */
+		binary_semaphore_t done;
+	}capture;
+	struct
+	{
+		uint8_t         repeats;                /** Repeats of holding key of ON action. */
+		keymap_action_t action;                 /** Action to learn key for, NONE when not learning. */
+		systimestamp_t  time;                   /** Start of learning of current action. */
+	}combo;
+}learn_context;
+
+/* Count presses of the same key, returns true when key is pressed enough times. */
+static bool learn_key(const ir_event_t *event, uint8_t frames)
+{
+	if (event->repeat)
+	{
+		return false;
+	}
+	if ((learn_context.key.frames == 0) || (learn_context.key.address != event->address) || (learn_context.key.command != event->command))
+	{
+		learn_context.key.address = event->address;
+		learn_context.key.command = event->command;
+		learn_context.key.frames = 0;
+	}
+	learn_context.key.frames++;
+	if (learn_context.key.frames < frames)
+	{
+		return false;
+	}
+	learn_context.key.frames = 0;
+	return true;
+}
+
+static bool learn_capture_event(const ir_event_t *event)
+{
+	bool done;
+
+	chSysLock();
+	if (!learn_context.capture.active)
+	{
+		chSysUnlock();
+		return false;
+	}
+	done = learn_key(event, learn_context.capture.frames);
+	if (done)
+	{
+		learn_context.capture.active = false;
+		chBSemSignalI(&learn_context.capture.done);
+		chSchRescheduleS();
+	}
+	chSysUnlock();
+	return true;
+}
+
+static bool learn_combo_event(const ir_event_t *event)
+{
+	if (learn_context.combo.action == KEYMAP_ACTION_NONE)
+	{
+		if (!event->repeat || (keymap_lookup(event->address, event->command) != KEYMAP_ACTION_ON))
+		{
+			learn_context.combo.repeats = 0;
+			return false;
+		}
+		if (++learn_context.combo.repeats < LEARN_COMBO_REPEATS)
+		{
+			return false;
+		}
+		learn_context.combo.repeats = 0;
+		learn_context.combo.action = KEYMAP_ACTION_NONE + 1;
+		learn_context.combo.time = event->time;
+		learn_context.key.frames = 0;
+		return true;
+	}
+
+	/* Time stamps don't wrap, timeout is longer than system time range. */
+	if ((event->time - learn_context.combo.time) > TIME_MS2I(LEARN_TIMEOUT_MSEC))
+	{
+		learn_context.combo.action = KEYMAP_ACTION_NONE;
+		return false;
+	}
+	if (learn_key(event, LEARN_FRAMES))
+	{
+		(void)keymap_bind(learn_context.key.address, learn_context.key.command, learn_context.combo.action);
+		learn_context.combo.action++;
+		learn_context.combo.time = event->time;
+		if (learn_context.combo.action == LEARN_COMBO_END)
+		{
+			learn_context.combo.action = KEYMAP_ACTION_NONE;
+			(void)keymap_save();
+		}
+	}
+	return true;
+}
+
+void learn_initialize(void)
+{
+	chBSemObjectInit(&learn_context.capture.done, true);
+}
+
+bool learn_event(const ir_event_t *event)
+{
+	return learn_capture_event(event) || learn_combo_event(event);
+}
+
+bool learn_capture(uint8_t frames, sysinterval_t timeout, uint16_t *address, uint8_t *command)
+{
+	msg_t result;
+
+	chSysLock();
+	chBSemResetI(&learn_context.capture.done, true);
+	learn_context.key.frames = 0;
+	learn_context.capture.frames = frames;
+	learn_context.capture.active = true;
+	chSysUnlock();
+
+	result = chBSemWaitTimeout(&learn_context.capture.done, timeout);
+
+	chSysLock();
+	learn_context.capture.active = false;
+	*address = learn_context.key.address;
+	*command = learn_context.key.command;
+	chSysUnlock();
+	return result == MSG_OK;
+}
@@ -4,109 +4,207 @@
 #include "usbcfg.h"
 #include "chprintf.h"
 #include "ir.h"
+#include "ring.h"
 #include "pwm.h"
+#include "fade.h"
+#include "colour.h"
+#include "lamp.h"
+#include "power.h"
+#include "storage.h"
+#include "keymap.h"
+#include "learn.h"
+#include "commands.h"
 #include "config.h"
 
+#define LOG_RING_SIZE             32 /* Received commands waiting for print, power of two. */
+
 struct context
 {
 	BaseSequentialStream * chp; /* For print to serial port. */
-	uint8_t brightness_value;
-	bool brightness_on;
-	bool was_command;
-	uint16_t cmd_address;
-	uint8_t cmd_command;
-	uint8_t cmd_repeat;
+	struct
+	{
+		ir_event_t buffer[LOG_RING_SIZE];
+		ring_t ring;               /* Filled by remote thread, drained by logger. */
+		uint32_t dropped;          /* Commands not logged because ring was full. */
+		binary_semaphore_t ready;  /* Signalled when command is pushed. */
+	}log;
+	uint8_t hold_repeats; /* Repeats since key press, for ramp acceleration. */
 };
 
-#define REMOTE_1_ADDRESS          0x7f00
-#define REMOTE_1_COMMAND_OFF      0x53
-#define REMOTE_1_COMMAND_ON       0x52
-#define REMOTE_1_COMMAND_PLUS     0x51
-#define REMOTE_1_COMMAND_MINUS    0x50
+#define BRIGHTNESS_STEP           10 /* Brightness change per key press, percents. */
+#define BRIGHTNESS_RAMP_STEP_MIN  1  /* Brightness change per first repeats of holding key, percents. */
+#define BRIGHTNESS_RAMP_STEP_MAX  5  /* Brightness change per repeat of long holding key, percents. */
+#define BRIGHTNESS_RAMP_REPEATS   4  /* Repeats of holding key to increase change by one percent. */
+#define BRIGHTNESS_FADE_MSEC      300 /* Duration of brightness change, the same for any change. */
+#define BRIGHTNESS_DEFAULT        50 /* Brightness at boot when nothing is saved, percents. */
 
-#define REMOTE_2_ADDRESS          0xff00
-#define REMOTE_2_COMMAND_OFF      0x06
-#define REMOTE_2_COMMAND_ON       0x07
-#define REMOTE_2_COMMAND_PLUS     0x05
-#define REMOTE_2_COMMAND_MINUS    0x04
-
-static void remote_command(void *context, uint16_t address, uint8_t command, bool repeat)
+/* Brightness change for key press or for current repeat of holding key. */
+static uint8_t brightness_step(struct context *ctx, bool repeat)
 {
-	struct context *ctx = (struct context*)context;
-	enum
-	{
-		REMOTE_CMD_NONE = 0,
-		REMOTE_CMD_OFF,
-		REMOTE_CMD_ON,
-		REMOTE_CMD_PLUS,
-		REMOTE_CMD_MINUS,
-	} remote_command = REMOTE_CMD_NONE;
+	uint8_t step;
 
+	if (!repeat)
+	{
+		ctx->hold_repeats = 0;
+		return BRIGHTNESS_STEP;
+	}
 
-	ctx->cmd_repeat = repeat;
-	ctx->cmd_command = command;
-	ctx->cmd_address = address;
-	ctx->was_command = true;
-
-	if (repeat) { return; }
-
-	if (address == REMOTE_1_ADDRESS)
+	/* Repeats come while key is holding, so ramp stops at the first missed repeat. */
+	step = BRIGHTNESS_RAMP_STEP_MIN + ctx->hold_repeats / BRIGHTNESS_RAMP_REPEATS;
+	if (step > BRIGHTNESS_RAMP_STEP_MAX)
 	{
-		switch (command)
-		{
-			case REMOTE_1_COMMAND_ON: remote_command = REMOTE_CMD_ON; break;
-			case REMOTE_1_COMMAND_OFF: remote_command = REMOTE_CMD_OFF; break;
-			case REMOTE_1_COMMAND_PLUS: remote_command = REMOTE_CMD_PLUS; break;
-			case REMOTE_1_COMMAND_MINUS: remote_command = REMOTE_CMD_MINUS; break;
-			default: break;
-		}
+		step = BRIGHTNESS_RAMP_STEP_MAX;
 	}
-	else if (address == REMOTE_2_ADDRESS)
+	else
 	{
-		switch (command)
-		{
-			case REMOTE_2_COMMAND_ON: remote_command = REMOTE_CMD_ON; break;
-			case REMOTE_2_COMMAND_OFF: remote_command = REMOTE_CMD_OFF; break;
-			case REMOTE_2_COMMAND_PLUS: remote_command = REMOTE_CMD_PLUS; break;
-			case REMOTE_2_COMMAND_MINUS: remote_command = REMOTE_CMD_MINUS; break;
-			default: break;
-		}
+		ctx->hold_repeats++;
 	}
+	return step;
+}
+
+static void remote_command(struct context *ctx, const ir_event_t *event)
+{
+	const uint16_t address = event->address;
+	const uint8_t command = event->command;
+	const bool repeat = event->repeat;
+	const keymap_action_t action = keymap_lookup(address, command);
+	lamp_state_t *state;
 
-	switch (remote_command)
+	if (repeat && (action != KEYMAP_ACTION_PLUS) && (action != KEYMAP_ACTION_MINUS) &&
+	    (action != KEYMAP_ACTION_WARMER) && (action != KEYMAP_ACTION_COOLER))
+	{
+		/* Only brightness and CCT are ramping while key is holding. */
+		return;
+	}
+
+	/* Changed state is published at once, smoothing thread is woken up only if something is changed. */
+	state = lamp_begin();
+	switch (action)
 	{
 		default:
-		case REMOTE_CMD_NONE:
+		case KEYMAP_ACTION_NONE:
 			break;
-		case REMOTE_CMD_OFF:
-			ctx->brightness_on = false;
+		case KEYMAP_ACTION_OFF:
+			state->on = false;
 			break;
-		case REMOTE_CMD_ON:
-			ctx->brightness_on = true;
+		case KEYMAP_ACTION_ON:
+			state->on = true;
 			break;
-		case REMOTE_CMD_PLUS:
-			if (ctx->brightness_on)
+		case KEYMAP_ACTION_PLUS:
+			if (state->on)
 			{
-				uint8_t tmp = ctx->brightness_value;
-				tmp += 10;
+				uint8_t tmp = state->brightness;
+				tmp += brightness_step(ctx, repeat);
 				if (tmp > 100) { tmp = 100; }
-				ctx->brightness_value = tmp;
+				state->brightness = tmp;
 			}
 			break;
-		case REMOTE_CMD_MINUS:
-			if (ctx->brightness_on)
+		case KEYMAP_ACTION_MINUS:
+			if (state->on)
 			{
-				uint8_t tmp = ctx->brightness_value;
-				if (tmp < 10) { tmp = 0; }
-				else { tmp -= 10; }
-				ctx->brightness_value = tmp;
+				uint8_t tmp = state->brightness;
+				uint8_t step = brightness_step(ctx, repeat);
+				if (tmp < step) { tmp = 0; }
+				else { tmp -= step; }
+				state->brightness = tmp;
 			}
 			break;
+#if COLOUR_TUNABLE_WHITE == TRUE
+		case KEYMAP_ACTION_WARMER:
+			state->cct = colour_limit_cct((int32_t)state->cct - (int32_t)COLOUR_CCT_STEP);
+			break;
+		case KEYMAP_ACTION_COOLER:
+			state->cct = colour_limit_cct((int32_t)state->cct + (int32_t)COLOUR_CCT_STEP);
+			break;
+#endif
+	}
+	lamp_commit();
+}
+
+/* Remote thread is the only producer, so push is lock free. */
+static void log_push(struct context *ctx, const ir_event_t *event)
+{
+	if (ring_is_full(&ctx->log.ring, LOG_RING_SIZE))
+	{
+		ctx->log.dropped++;
+		return;
+	}
+	ctx->log.buffer[ring_head_index(&ctx->log.ring, LOG_RING_SIZE)] = *event;
+	ring_push(&ctx->log.ring);
+	chBSemSignal(&ctx->log.ready);
+}
+
+/*
+ * Logger, prints every received command with time of reception since boot.
+ * Print may be slow, commands are not lost unless ring is full, then number of lost ones is printed.
+ * Commands lost before the remote thread, in queue of receiver, are printed too.
+ */
+static void log_print(struct context *ctx)
+{
+	static const char * const protocols[IR_PROTOCOL_COUNT] =
+	{
+		[IR_PROTOCOL_NEC] = "NEC",
+		[IR_PROTOCOL_RC5] = "RC5",
+		[IR_PROTOCOL_RC6] = "RC6",
+		[IR_PROTOCOL_SIRC] = "SIRC",
+		[IR_PROTOCOL_SAMSUNG32] = "Samsung32",
+	};
+	uint32_t dropped = 0;
+	uint32_t lost = 0;
+
+	while (true)
+	{
+		(void)chBSemWait(&ctx->log.ready);
+		while (!ring_is_empty(&ctx->log.ring))
+		{
+			const ir_event_t *event = &ctx->log.buffer[ring_tail_index(&ctx->log.ring, LOG_RING_SIZE)];
+			const uint32_t seconds = (uint32_t)(event->time / CH_CFG_ST_FREQUENCY);
+			const uint32_t msec = (uint32_t)(event->time % CH_CFG_ST_FREQUENCY) * 1000U / CH_CFG_ST_FREQUENCY;
+			chprintf(ctx->chp, "%lu.%03lu s: %s address 0x%04X, command 0x%02X, repeat %d\n\r",
+			         (unsigned long)seconds, (unsigned long)msec, protocols[event->protocol],
+			         event->address, event->command, event->repeat);
+			ring_pop(&ctx->log.ring);
+		}
+		if (ctx->log.dropped != dropped)
+		{
+			chprintf(ctx->chp, "%lu commands are not logged\n\r", (unsigned long)(ctx->log.dropped - dropped));
+			dropped = ctx->log.dropped;
+		}
+		if (ir_lost_events() != lost)
+		{
+			const uint32_t now_lost = ir_lost_events();
+			chprintf(ctx->chp, "%lu commands are lost by receiver\n\r", (unsigned long)(now_lost - lost));
+			lost = now_lost;
+		}
 	}
 }
 
 /*
- * Blinker thread.
+ * Remote control thread, handles received commands in thread context.
+ */
+static THD_WORKING_AREA(area_remote_thread, 256);
+static THD_FUNCTION(remote_thread, arg)
+{
+	struct context *c = (struct context *)arg;
+	chRegSetThreadName("remote");
+
+	while (true)
+	{
+		ir_event_t event;
+		if (!ir_event_get(&event, TIME_INFINITE))
+		{
+			continue;
+		}
+		log_push(c, &event);
+		if (!learn_event(&event))
+		{
+			remote_command(c, &event);
+		}
+	}
+}
+
+/*
+ * Blinker thread, stops with LED off while lamp is dark.
  */
 static THD_WORKING_AREA(area_led_thread, 128);
 static THD_FUNCTION(led_thread, arg) 
@@ -117,76 +215,183 @@ static THD_FUNCTION(led_thread, arg)
 	while (true) 
 	{
 		palSetPad(GPIOC, GPIOC_BOARD_LED);
+		power_wait_light();
 		chThdSleepMilliseconds(950);
 		palClearPad(GPIOC, GPIOC_BOARD_LED);
 		chThdSleepMilliseconds(50);
 	}
 }
 
-static THD_WORKING_AREA(area_pwm_thread, 128);
+#if PWM_CHANNELS > PWM_DMA_CHANNELS
+#define PWM_AUX_CHANNELS  (((1U << PWM_CHANNELS) - 1U) & ~((1U << PWM_DMA_CHANNELS) - 1U)) /* Channels not driven by fade engine. */
+
+/*
+ * Channels beyond the ones of fade engine follow target level without fade and dithering,
+ * all of them are switched in the same PWM period.
+ */
+static void pwm_aux_set(uint16_t level)
+{
+	uint16_t values[PWM_CHANNELS] = {0};
+	const uint16_t ticks = (uint16_t)(pwm_level_ticks(level) >> PWM_FRACTION_BITS);
+	uint32_t channel;
+
+	for (channel = PWM_DMA_CHANNELS; channel < PWM_CHANNELS; channel++)
+	{
+		values[channel] = ticks;
+	}
+	pwm_set_channels(values, PWM_AUX_CHANNELS);
+}
+#endif
+
+/*
+ * Brightness smoothing thread, sleeps until lamp state is changed.
+ * Fade is done by DMA of fade engine, so thread only starts it.
+ * Lamp is dark when fade to zero is done, then power manager may stop MCU.
+ * Brightness and CCT are saved when they are not changed for a while, or before MCU may be stopped,
+ * because timeouts are frozen in STOP mode.
+ */
+static THD_WORKING_AREA(area_pwm_thread, 256);
 static THD_FUNCTION(pwm_thread, arg)
 {
-	const struct context *c = (const struct context *)arg;
-	uint16_t pwm_value = 0; /* Value to pwm set. */
+	event_listener_t lamp_listener;
+	event_listener_t fade_listener;
+	lamp_state_t state;
+	uint16_t pwm_level; /* Target of fade engine. */
+	bool save_pending = false; /* Lamp state is changed, but not saved. */
+	(void)arg;
 	chRegSetThreadName("pwm_smooth");
+	chEvtRegisterMask(lamp_event_source(), &lamp_listener, EVENT_MASK(0));
+	chEvtRegisterMaskWithFlags(fade_event_source(), &fade_listener, EVENT_MASK(1), FADE_EVENT_DONE);
+
+	/* Boot state is already applied by main. */
+	lamp_get(&state);
+	pwm_level = state.on ? PWM_PERCENT_TO_LEVEL(state.brightness) : 0;
+	if (pwm_level == 0)
+	{
+		power_set_dark(pwm_is_off());
+	}
 
 	while (true)
 	{
-		uint16_t pwm_expected_value = 0; /* Value to pwm set. */
-		if (c->brightness_on)
+		uint16_t pwm_expected_level = 0;
+		const eventmask_t events = chEvtWaitAnyTimeout(ALL_EVENTS,
+		                                               save_pending ? TIME_MS2I(LAMP_SAVE_DELAY_MSEC) : TIME_INFINITE);
+
+		if (events == 0)
 		{
-			pwm_expected_value = c->brightness_value; /* Value to pwm set. */
-			pwm_expected_value *= c->brightness_value; /* Value to pwm set. */
+			/* Flash is programmed after fade is done, so stalled DMA interrupt repeats constant compare values. */
+			(void)lamp_save();
+			save_pending = false;
+			continue;
 		}
-		if (pwm_value > pwm_expected_value)
+		if ((events & EVENT_MASK(1)) && (pwm_level == 0))
 		{
-			if (pwm_value >= 10)
+			if (save_pending)
 			{
-				pwm_value-=10;
+				(void)lamp_save();
+				save_pending = false;
 			}
-			else
-			{
-				pwm_value = 0;
-			}
-			pwm_set(pwm_value);
-			chThdSleepMilliseconds(1);
+			power_set_dark(pwm_is_off());
 		}
-		else if (pwm_value < pwm_expected_value)
+		if (!(events & EVENT_MASK(0)))
 		{
-			pwm_value+=10;
-			if (pwm_value > 10000)
+			continue;
+		}
+		save_pending = true;
+		lamp_get(&state);
+#if COLOUR_TUNABLE_WHITE == TRUE
+		if (state.cct != colour_cct())
+		{
+			colour_set_cct(state.cct);
+		}
+#endif
+		if (state.on)
+		{
+			pwm_expected_level = PWM_PERCENT_TO_LEVEL(state.brightness);
+		}
+		if (pwm_level != pwm_expected_level)
+		{
+			pwm_level = pwm_expected_level;
+			if (pwm_level != 0)
 			{
-				pwm_value = 10000;
+				power_set_dark(false);
 			}
-			pwm_set(pwm_value);
-			chThdSleepMilliseconds(1);
+#if PWM_CHANNELS > PWM_DMA_CHANNELS
+			pwm_aux_set(pwm_level);
+#endif
+			fade_to(pwm_level, BRIGHTNESS_FADE_MSEC, FADE_EASE_IN_OUT);
 		}
-		else
+		else if (pwm_level == 0)
 		{
-			chThdSleepMilliseconds(10);
+			(void)lamp_save();
+			save_pending = false;
+			power_set_dark(pwm_is_off());
 		}
 	}
 }
 
+/*
+ * USB thread, activates bus in background, so lamp is lit at boot without waiting for it.
+ * MCU is not stopped until USB is started, so the delay of disconnection is not frozen.
+ */
+static THD_WORKING_AREA(area_usb_thread, 128);
+static THD_FUNCTION(usb_thread, arg)
+{
+	(void)arg;
+	chRegSetThreadName("usb");
+
+	/* Host sees disconnection, so device is enumerated again after reset. */
+	usbDisconnectBus(serusbcfg.usbp);
+	chThdSleepMilliseconds(1500);
+	usbStart(serusbcfg.usbp, &usbcfg);
+	usbConnectBus(serusbcfg.usbp);
+	commands_set_boot_usb(TIME_I2MS(chVTGetSystemTimeX()));
+}
+
 int main(void) 
 {
 	struct context context = {};
+	lamp_state_t *state;
+
+	/* Boot to light is counted in cycles from here, clocks are already started by early initialization. */
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
 	halInit();     /* Initialize hardware. */
 	chSysInit();   /* Initialize OS. */
 
+	/* Lamp is switched on with the last saved brightness and CCT, before USB and other modules. */
+	pwm_initialize();
+	storage_initialize();
+	lamp_initialize();
+	state = lamp_begin();
+	state->on = true;
+	state->brightness = BRIGHTNESS_DEFAULT;
+#if COLOUR_TUNABLE_WHITE == TRUE
+	state->cct = COLOUR_CCT_DEFAULT;
+#endif
+	(void)lamp_load(state);
+#if COLOUR_TUNABLE_WHITE == TRUE
+	state->cct = colour_limit_cct(state->cct);
+	colour_set_cct(state->cct);
+#endif
+	/* The first PWM periods sent by DMA already have the level. */
+#if PWM_CHANNELS > PWM_DMA_CHANNELS
+	pwm_aux_set(PWM_PERCENT_TO_LEVEL(state->brightness));
+#endif
+	fade_to(PWM_PERCENT_TO_LEVEL(state->brightness), 0, FADE_LINEAR);
+	fade_initialize();
+	lamp_commit();
+	commands_set_boot_light(chSysGetRealtimeCounterX() / (STM32_SYSCLK / 1000000U));
 
-	/* Initialize and start serial over USB driver. */
+	/* Initialize and start serial over USB driver, bus is activated by its thread. */
 	sduObjectInit(&SDU1);
 	sduStart(&SDU1, &serusbcfg);
 
-	/* Activate bus. */
-	usbDisconnectBus(serusbcfg.usbp);
-	chThdSleepMilliseconds(1500);
-	usbStart(serusbcfg.usbp, &usbcfg);
-	usbConnectBus(serusbcfg.usbp);
-
-
 	/* Create threads. */
+	power_initialize();
+	chBSemObjectInit(&context.log.ready, true);
 	chThdCreateStatic(area_led_thread, 
 	                  sizeof(area_led_thread), 
 	                  NORMALPRIO+1, 
@@ -197,32 +402,33 @@ int main(void)
 	                  sizeof(area_pwm_thread),
 	                  NORMALPRIO+1,
 	                  pwm_thread,
-	                  &context);
+	                  NULL);
+
+	chThdCreateStatic(area_usb_thread,
+	                  sizeof(area_usb_thread),
+	                  NORMALPRIO,
+	                  usb_thread,
+	                  NULL);
 
 
 	/* Set base stream to USB-serial */
 	context.chp = (BaseSequentialStream *)&SDU1;
 
+	/* Load remote keys and start shell. */
+	keymap_initialize();
+	learn_initialize();
+	commands_initialize(&SDU1);
+
+	chThdCreateStatic(area_remote_thread,
+	                  sizeof(area_remote_thread),
+	                  NORMALPRIO+1,
+	                  remote_thread,
+	                  &context);
+
 	/* Initialize infrared receiver. */
 	ir_initialize();
-	ir_set_callback(remote_command, &context);
-
-	/* Initialize PWM controller. */
-	pwm_initialize();
-	palSetPadMode(PWM_PORT, PWM_PIN, PAL_MODE_STM32_ALTERNATE_PUSHPULL);
-	context.brightness_value = 50;
+	ir_enable_events();
 
-	while (true)
-	{
-		if (context.was_command)
-		{
-			chprintf(context.chp,"address 0x%04X, command 0x%02X, repeat %d\n\r", context.cmd_address, context.cmd_command, context.cmd_repeat);
-			context.was_command = false;
-			context.cmd_repeat = 0;
-		}
-		else
-		{
-			chThdSleepMilliseconds(100);
-		}
-	}
+	/* Main thread is logger of received commands. */
+	log_print(&context);
 }
@@ -0,0 +1,117 @@
+#include <hal.h>
+#include "ch.h"
+#include "usbcfg.h"
+#include "power.h"
+#include "ir.h"
+#include "config.h"
+
+#if !defined(POWER_STOP) || !defined(POWER_USB_WAKEUP_IRQ_PRIORITY)
+#error Power manager is not configured!
+#endif
+
+#define POWER_STOP_WAKEUP_USEC    6u          /** Wakeup of regulator in low power mode and HSI, datasheet maximum. */
+#define POWER_USB_WAKEUP_LINE     18u         /** EXTI line of USB wakeup event. */
+#define POWER_USB_WAKEUP_HANDLER  VectorE8    /** USBWakeUp interrupt, EXTI line 18. */
+
+/*
+ * Power manager.
+ * While lamp is dark, unused threads are gated by power_wait_light() and idle thread stops MCU:
+ * all clocks are off, so system time and timeouts are frozen too. STOP is left by any EXTI interrupt:
+ * edge of infrared receiver or USB wakeup (bus activity while USB is suspended).
+ * USB needs its clock, so MCU is stopped only while USB is not active, otherwise idle thread sleeps by WFI.
+ * USB is started by its thread after boot delay, MCU is not stopped before, so the delay is not frozen.
+ * MCU wakes up with HSI clock, PLL is started again before the interrupt is served,
+ * and the infrared edge which woke MCU is timestamped back by the time of restart.
+ */
+static struct
+{
+	bool                  enabled;             /** STOP mode is allowed. */
+	volatile bool         dark;                /** All PWM channels are off. */
+	threads_queue_t       light_waiters;       /** Threads gated while lamp is dark. */
+	power_statistics_t    statistics;
+}power_context;
+
+OSAL_IRQ_HANDLER(POWER_USB_WAKEUP_HANDLER)
+{
+	OSAL_IRQ_PROLOGUE();
+	EXTI->PR = 1U << POWER_USB_WAKEUP_LINE;
+	OSAL_IRQ_EPILOGUE();
+}
+
+/* Called by idle thread with interrupts enabled, interrupt which wakes MCU is served after clocks are restarted. */
+void power_idle(void)
+{
+#if POWER_STOP == TRUE
+	rtcnt_t start;
+	uint32_t usec;
+
+	if (!power_context.enabled || !power_context.dark)
+	{
+		return;
+	}
+
+	__disable_irq();
+	if (power_context.dark && (serusbcfg.usbp->state != USB_STOP) && (serusbcfg.usbp->state != USB_ACTIVE) && ir_is_quiet())
+	{
+		PWR->CR = (PWR->CR & ~PWR_CR_PDDS) | PWR_CR_LPDS;
+		SCB->SCR |= SCB_SCR_SLEEPDEEP_Msk;
+		__WFI();
+		SCB->SCR &= ~SCB_SCR_SLEEPDEEP_Msk;
+
+		/* Restart is counted in cycles of HSI, the clock after wakeup. */
+		start = chSysGetRealtimeCounterX();
+		stm32_clock_init();
+		usec = POWER_STOP_WAKEUP_USEC + (chSysGetRealtimeCounterX() - start) / (STM32_HSICLK / 1000000U);
+
+		power_context.statistics.stops++;
+		power_context.statistics.wakeup_usec = usec;
+		if (EXTI->PR & (1U << IR_PIN))
+		{
+			power_context.statistics.ir_wakeups++;
+			ir_wakeup(usec);
+		}
+	}
+	__enable_irq();
+#endif
+}
+
+void power_set_dark(bool dark)
+{
+	chSysLock();
+	power_context.dark = dark;
+	if (!dark)
+	{
+		chThdDequeueAllI(&power_context.light_waiters, MSG_OK);
+		chSchRescheduleS();
+	}
+	chSysUnlock();
+}
+
+void power_wait_light(void)
+{
+	chSysLock();
+	if (power_context.dark)
+	{
+		(void)chThdEnqueueTimeoutS(&power_context.light_waiters, TIME_INFINITE);
+	}
+	chSysUnlock();
+}
+
+void power_get_statistics(power_statistics_t *statistics)
+{
+	chSysLock();
+	*statistics = power_context.statistics;
+	chSysUnlock();
+}
+
+void power_initialize(void)
+{
+	chThdQueueObjectInit(&power_context.light_waiters);
+#if POWER_STOP == TRUE
+	rccEnablePWRInterface(true);
+	EXTI->IMR |= 1U << POWER_USB_WAKEUP_LINE;
+	EXTI->RTSR |= 1U << POWER_USB_WAKEUP_LINE;
+	nvicEnableVector(USBWakeUp_IRQn, POWER_USB_WAKEUP_IRQ_PRIORITY);
+	power_context.enabled = true;
+#endif
+}
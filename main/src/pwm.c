@@ -1,54 +1,494 @@
 #include <hal.h>
+#include "ch.h"
 #include "pwm.h"
 #include "config.h"
 
+#define PWM_TICKS_MIN     (PWM_FREQUENCY / 400000U) /** 2.5 us, couldn't use very low values, there is to slow interrupts. */
+#define PWM_PERIODS_PER_SEC (PWM_FREQUENCY / PWM_PERIOD)
+#define PWM_PULSE_RATE_MIN  200U                    /** Pulses per second below PWM_TICKS_MIN, slower ones flicker. */
+#define PWM_DITHER_MIN    (((PWM_TICKS_MIN << PWM_FRACTION_BITS) * PWM_PULSE_RATE_MIN + PWM_PERIODS_PER_SEC - 1U) / PWM_PERIODS_PER_SEC)
+
+#if !defined(PWM_CURVE) || !defined(PWM_DITHER)
+#error Brightness curve is not configured!
+#endif
+
+/*
+ * Brightness curve is evaluated by compiler, table is constant in flash.
+ * Float constant expressions are folded at compile time, so there is no float code at runtime.
+ * CIE 1931 lightness: Y = ((L + 16) / 116)^3, or Y = L / 903.3 for L <= 8, where L is 0..100.
+ */
+#define PWM_CURVE_LIGHTNESS(level)  ((level) * 100.0 / PWM_LEVEL_MAX)
+#define PWM_CURVE_CIE(l)            (((l) > 8.0) ? (((l) + 16.0) / 116.0) * (((l) + 16.0) / 116.0) * (((l) + 16.0) / 116.0) : (l) / 903.3)
+#define PWM_CURVE_RATIO(level)      ((double)(level) / PWM_LEVEL_MAX)
+
+#if PWM_CURVE == PWM_CURVE_CIE1931
+#define PWM_CURVE_Y(level)          PWM_CURVE_CIE(PWM_CURVE_LIGHTNESS(level))
+#elif PWM_CURVE == PWM_CURVE_QUADRATIC
+#define PWM_CURVE_Y(level)          (PWM_CURVE_RATIO(level) * PWM_CURVE_RATIO(level))
+#elif PWM_CURVE == PWM_CURVE_CUBIC
+#define PWM_CURVE_Y(level)          (PWM_CURVE_RATIO(level) * PWM_CURVE_RATIO(level) * PWM_CURVE_RATIO(level))
+#else
+#error Unknown brightness curve!
+#endif
+
+#define PWM_CURVE_TICKS(level)      ((uint32_t)(PWM_CURVE_Y(level) * (PWM_PERIOD << PWM_FRACTION_BITS) + 0.5))
+
+#define PWM_LEVELS_1(level)         PWM_CURVE_TICKS(level),
+#define PWM_LEVELS_4(level)         PWM_LEVELS_1(level) PWM_LEVELS_1((level) + 1) PWM_LEVELS_1((level) + 2) PWM_LEVELS_1((level) + 3)
+#define PWM_LEVELS_16(level)        PWM_LEVELS_4(level) PWM_LEVELS_4((level) + 4) PWM_LEVELS_4((level) + 8) PWM_LEVELS_4((level) + 12)
+#define PWM_LEVELS_64(level)        PWM_LEVELS_16(level) PWM_LEVELS_16((level) + 16) PWM_LEVELS_16((level) + 32) PWM_LEVELS_16((level) + 48)
+#define PWM_LEVELS_256(level)       PWM_LEVELS_64(level) PWM_LEVELS_64((level) + 64) PWM_LEVELS_64((level) + 128) PWM_LEVELS_64((level) + 192)
+#define PWM_LEVELS_1024(level)      PWM_LEVELS_256(level) PWM_LEVELS_256((level) + 256) PWM_LEVELS_256((level) + 512) PWM_LEVELS_256((level) + 768)
+
+#if PWM_LEVEL_MAX != 1023
+#error Brightness table is generated for 1024 levels!
+#endif
+
+/** Timer compare value for each brightness level, with fraction. */
+static const uint32_t pwm_levels[PWM_LEVEL_MAX + 1] =
+{
+	PWM_LEVELS_1024(0)
+};
+
+#if !defined(PWM_CHANNELS) || (PWM_CHANNELS < 1) || (PWM_CHANNELS > 8) || !defined(PWM_STAGGER)
+#error PWM channels are not configured!
+#endif
+
+#if PWM_CHANNELS < PWM_DMA_CHANNELS
+#error Tunable white needs two PWM channels!
+#endif
+
+#define PWM_TIMER_CHANNELS    4U    /** Channels 0..3 are on TIM3, 4..7 on TIM4. */
+#define PWM_TIMERS            ((PWM_CHANNELS + PWM_TIMER_CHANNELS - 1) / PWM_TIMER_CHANNELS)
+#define PWM_BENCHMARK_RUNS    100U
+#define PWM_BENCHMARK_CHANNEL (PWM_CHANNELS - 1U) /** Channel of pwm_ticks_set(), if it is not written by DMA. */
+#define PWM_UPDATE_GUARD      (PWM_FREQUENCY / 500000U) /** Ticks before update (2 us), when preload registers are not changed. */
+
+static const struct
+{
+	ioportid_t port;
+	uint8_t pin;
+}pwm_pins[8] = { PWM_CHANNEL_PINS };
+
 static struct
 {
-	PWMDriver *driver;
-	PWMConfig config;
+	PWMDriver *drivers[PWM_TIMERS];
+	PWMConfig configs[PWM_TIMERS];
+	PWMDriver *driver;                  /** Driver of channel 0. */
 	bool active_level;
-}pwm_context;
+	uint16_t duties[PWM_CHANNELS];      /** Duties of channels, timer ticks. */
+	uint32_t alignment;                 /** Mask of back aligned channels. */
+	uint32_t pending_alignment;         /** Alignment to set at the next update. */
+}pwm_context =
+{
+	.alignment = PWM_DMA_BACK_CHANNELS,
+	.pending_alignment = PWM_DMA_BACK_CHANNELS,
+};
+
+/*
+ * First order sigma-delta modulation of compare value, called once per PWM period.
+ * Rounding error of each period is added to the next one, so average of compare values is exact:
+ * fraction of tick is spread over up to 16 periods.
+ * Values below PWM_TICKS_MIN are made from pulses of PWM_TICKS_MIN and periods without pulse,
+ * so brightness goes down smoothly, with flashes PWM_TICKS_MIN long at the lowest levels.
+ * Values are limited by PWM_DITHER_MIN, so flashes are at least PWM_PULSE_RATE_MIN per second:
+ * the lowest levels of 400 Hz profile are the same, faster profiles reach lower brightness.
+ */
+uint16_t pwm_quantize(int32_t *error, uint32_t target)
+{
+#if PWM_DITHER == TRUE
+	int32_t value;
+	uint32_t ticks;
+
+	if ((target != 0) && (target < PWM_DITHER_MIN)) { target = PWM_DITHER_MIN; }
+	value = (int32_t)target + *error;
+
+	if (value >= (int32_t)(PWM_TICKS_MIN << PWM_FRACTION_BITS))
+	{
+		ticks = (uint32_t)value >> PWM_FRACTION_BITS;
+	}
+	else if (value >= (int32_t)(PWM_TICKS_MIN << (PWM_FRACTION_BITS - 1)))
+	{
+		ticks = PWM_TICKS_MIN;
+	}
+	else
+	{
+		ticks = 0;
+	}
+	*error = value - (int32_t)(ticks << PWM_FRACTION_BITS);
+	return (uint16_t)ticks;
+#else
+	uint32_t ticks = (target + (1U << (PWM_FRACTION_BITS - 1))) >> PWM_FRACTION_BITS;
+	(void)error;
+	if (target == 0) { return 0; } /** Zero is off, so MCU may be stopped. */
+	if (ticks < PWM_TICKS_MIN) { ticks = PWM_TICKS_MIN; }
+	return (uint16_t)ticks;
+#endif
+}
+
+/*
+ * Steady compare value of period index of pattern repeated every periods, a multiple of 16,
+ * so circular DMA may repeat it without CPU. Sum of pattern is exact: average is target, as of pwm_quantize().
+ * Ticks are spread evenly over periods, values below PWM_TICKS_MIN are made from evenly spread pulses,
+ * which are at least PWM_TICKS_MIN long and share the rest of sum. Pattern has at least PWM_PULSE_RATE_MIN
+ * pulses per second, so the lowest values are raised to whole number of such pulses.
+ */
+uint16_t pwm_pattern(uint32_t target, uint32_t index, uint32_t periods)
+{
+#if PWM_DITHER == TRUE
+	const uint32_t pulses_min = (periods * PWM_PULSE_RATE_MIN + PWM_PERIODS_PER_SEC - 1U) / PWM_PERIODS_PER_SEC;
+	uint64_t total;
+	uint32_t pulses;
+	uint32_t pulse;
+	uint32_t rest = 0;
+
+	if (target == 0) { return 0; }
+	if (target < PWM_DITHER_MIN) { target = PWM_DITHER_MIN; }
+	total = ((uint64_t)target * periods) >> PWM_FRACTION_BITS;
+
+	if (target >= (PWM_TICKS_MIN << PWM_FRACTION_BITS))
+	{
+		return (uint16_t)((total * (index + 1U)) / periods - (total * index) / periods);
+	}
+	pulses = (uint32_t)(total / PWM_TICKS_MIN);
+	if (pulses < pulses_min)
+	{
+		pulses = pulses_min;
+	}
+	else
+	{
+		rest = (uint32_t)(total - (uint64_t)pulses * PWM_TICKS_MIN);
+	}
+	if ((pulses * (index + 1U)) / periods == (pulses * index) / periods) { return 0; }
+	pulse = (pulses * index) / periods;
+	return (uint16_t)(PWM_TICKS_MIN + (rest * (pulse + 1U)) / pulses - (rest * pulse) / pulses);
+#else
+	int32_t error = 0;
+	(void)index;
+	(void)periods;
+	return pwm_quantize(&error, target);
+#endif
+}
+
+uint32_t pwm_level_ticks(uint16_t level)
+{
+	if (level > PWM_LEVEL_MAX) { level = PWM_LEVEL_MAX; }
+	return pwm_levels[level];
+}
+
+static stm32_tim_t *pwm_channel_timer(uint32_t channel)
+{
+	return pwm_context.drivers[channel / PWM_TIMER_CHANNELS]->tim;
+}
+
+static uint16_t pwm_channel_compare(uint32_t channel, uint16_t duty)
+{
+	return (pwm_context.alignment & (1U << channel)) ? (uint16_t)(PWM_PERIOD - duty) : duty;
+}
+
+/*
+ * Period is a compile time constant, so compare value is only limited and stored to preload register,
+ * without multiplication and division of PWM_PERCENTAGE_TO_WIDTH() by period of driver.
+ */
+static inline void pwm_ticks_store(uint32_t channel, uint16_t ticks)
+{
+	if (ticks > PWM_PERIOD) { ticks = PWM_PERIOD; }
+	pwm_context.duties[channel] = ticks;
+	pwm_channel_timer(channel)->CCR[channel % PWM_TIMER_CHANNELS] = pwm_channel_compare(channel, ticks);
+}
+
+/* Duty of channel written by DMA, compare value of back aligned one is period - duty. */
+static uint16_t pwm_dma_duty(uint32_t channel)
+{
+	return pwm_channel_compare(channel, (uint16_t)pwm_channel_timer(channel)->CCR[channel]);
+}
+
+bool pwm_is_off(void)
+{
+	uint32_t channel;
+
+	for (channel = 0; channel < PWM_CHANNELS; channel++)
+	{
+		const uint32_t duty = (channel < PWM_DMA_CHANNELS) ? pwm_dma_duty(channel) : pwm_context.duties[channel];
+		if (duty != 0)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+ * Average CPU cycles of one compare value update by PWM_PERCENTAGE_TO_WIDTH() of channel 0
+ * and by pwm_ticks_set() of the last channel, without cycles of empty loop.
+ * Compare values are restored, so at most one period is changed. Lamp without channels
+ * other than DMA ones has no channel for pwm_ticks_set(), its cycles are 0.
+ */
+void pwm_benchmark(pwm_benchmark_t *result)
+{
+	volatile uint16_t value = 5000U; /** Not known to compiler, as argument of real call. */
+	const uint32_t compare = pwm_channel_timer(0)->CCR[0];
+	rtcnt_t start;
+	rtcnt_t empty;
+	rtcnt_t percentage;
+	rtcnt_t ticks;
+	uint32_t i;
+
+	chSysLock();
+	start = chSysGetRealtimeCounterX();
+	for (i = 0; i < PWM_BENCHMARK_RUNS; i++)
+	{
+		(void)value;
+	}
+	empty = chSysGetRealtimeCounterX() - start;
+
+	start = chSysGetRealtimeCounterX();
+	for (i = 0; i < PWM_BENCHMARK_RUNS; i++)
+	{
+		pwmEnableChannelI(pwm_context.driver, 0, PWM_PERCENTAGE_TO_WIDTH(pwm_context.driver, value));
+	}
+	percentage = chSysGetRealtimeCounterX() - start;
+
+	pwm_channel_timer(0)->CCR[0] = compare;
+
+#if PWM_CHANNELS > PWM_DMA_CHANNELS
+	{
+		const uint16_t duty = pwm_context.duties[PWM_BENCHMARK_CHANNEL];
+
+		start = chSysGetRealtimeCounterX();
+		for (i = 0; i < PWM_BENCHMARK_RUNS; i++)
+		{
+			pwm_ticks_set(PWM_BENCHMARK_CHANNEL, value);
+		}
+		ticks = chSysGetRealtimeCounterX() - start;
+		pwm_ticks_set(PWM_BENCHMARK_CHANNEL, duty);
+	}
+#else
+	ticks = empty;
+#endif
+	chSysUnlock();
+
+	result->percentage_cycles = (percentage - empty) / PWM_BENCHMARK_RUNS;
+	result->ticks_cycles = (ticks - empty) / PWM_BENCHMARK_RUNS;
+}
+
+#if PWM_STAGGER == TRUE
+/*
+ * Phase staggering: each channel is front aligned (PWM mode 1, on from the start of period)
+ * or back aligned (PWM mode 2, compare value is period - duty, on till the end of period).
+ * Channels are split greedily by duty, the largest first, to the group of smaller total duty,
+ * so pulses of the groups overlap as little as possible and supply current is spread over period.
+ * Channels 0..PWM_DMA_CHANNELS-1 are driven by fade engine by DMA, their alignment is fixed:
+ * warm white channel 0 is front aligned and cool white channel 1 is back aligned.
+ */
+static uint32_t pwm_stagger(void)
+{
+	uint8_t order[PWM_CHANNELS];
+	uint32_t count = 0;
+	uint32_t front = 0;
+	uint32_t back = 0;
+	uint32_t alignment = PWM_DMA_BACK_CHANNELS;
+	uint32_t i;
 
-void pwm_set(uint16_t value)
+	for (i = 0; i < PWM_DMA_CHANNELS; i++)
+	{
+		if (PWM_DMA_BACK_CHANNELS & (1U << i))
+		{
+			back += pwm_dma_duty(i);
+		}
+		else
+		{
+			front += pwm_dma_duty(i);
+		}
+	}
+
+	/* Insertion sort of the other channels by duty, descending. */
+	for (i = PWM_DMA_CHANNELS; i < PWM_CHANNELS; i++)
+	{
+		uint32_t j = count++;
+		while ((j > 0) && (pwm_context.duties[order[j - 1]] < pwm_context.duties[i]))
+		{
+			order[j] = order[j - 1];
+			j--;
+		}
+		order[j] = (uint8_t)i;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		const uint8_t channel = order[i];
+		if (back < front)
+		{
+			back += pwm_context.duties[channel];
+			alignment |= 1U << channel;
+		}
+		else
+		{
+			front += pwm_context.duties[channel];
+		}
+	}
+	return alignment;
+}
+
+static void pwm_channel_mode(stm32_tim_t *tim, uint32_t channel, bool back)
 {
-	if (value > 10000) { value = 10000; }
-	else if (value < 10) { value = 10; } /** Couldn't use very low values, there is to slow interrupts. */
-	pwmEnableChannel(pwm_context.driver, 0, PWM_PERCENTAGE_TO_WIDTH(pwm_context.driver, value));
+	volatile uint32_t *ccmr = (channel < 2) ? &tim->CCMR1 : &tim->CCMR2;
+	const uint32_t shift = (channel & 1U) ? 8U : 0U;
+	const uint32_t mode = back ? STM32_TIM_CCMR1_OC1M(7) : STM32_TIM_CCMR1_OC1M(6);
+
+	*ccmr = (*ccmr & ~(STM32_TIM_CCMR1_OC1M_MASK << shift)) | (mode << shift);
 }
 
-void pwm_corrected_set(uint8_t value)
+/*
+ * Alignment is changed just after update, with preload disabled,
+ * so new mode and new compare value start together, in the first microseconds of period.
+ */
+static void pwm_period_callback(PWMDriver *driver)
 {
-	uint16_t value_to_set;
-	if (value > 100) { value = 100; }
+	const uint32_t changed = pwm_context.alignment ^ pwm_context.pending_alignment;
+	uint32_t channel;
 
-	value_to_set = value;
-	value_to_set *= value_to_set;
+	pwm_context.alignment = pwm_context.pending_alignment;
+	for (channel = PWM_DMA_CHANNELS; channel < PWM_CHANNELS; channel++)
+	{
+		stm32_tim_t *tim = pwm_channel_timer(channel);
+		const uint32_t index = channel % PWM_TIMER_CHANNELS;
+		volatile uint32_t *ccmr = (index < 2) ? &tim->CCMR1 : &tim->CCMR2;
+		const uint32_t preload = STM32_TIM_CCMR1_OC1PE << ((index & 1U) ? 8U : 0U);
 
-	if (value_to_set < 10) { value_to_set = 10; } /** Couldn't use very low values, there is to slow interrupts. */
+		*ccmr &= ~preload;
+		if (changed & (1U << channel))
+		{
+			pwm_channel_mode(tim, index, (pwm_context.alignment & (1U << channel)) != 0);
+		}
+		tim->CCR[index] = pwm_channel_compare(channel, pwm_context.duties[channel]);
+		*ccmr |= preload;
+	}
 
-	pwmEnableChannel(pwm_context.driver, 0, PWM_PERCENTAGE_TO_WIDTH(pwm_context.driver, value_to_set));
+	chSysLockFromISR();
+	pwmDisablePeriodicNotificationI(driver);
+	chSysUnlockFromISR();
+}
+#endif
+
+/*
+ * Compare values of channels 0..PWM_DMA_CHANNELS-1 are overwritten by DMA every period, they are set by fade_to().
+ * Duty is only limited and stored, alignment of phase staggering is kept: it is recomputed by pwm_set_channels(),
+ * which is called by the same thread, so its interrupt doesn't change alignment meanwhile.
+ */
+void pwm_ticks_set(uint32_t channel, uint16_t ticks)
+{
+	chDbgAssert((channel >= PWM_DMA_CHANNELS) && (channel < PWM_CHANNELS), "wrong PWM channel");
+	pwm_ticks_store(channel, ticks);
+}
+
+/*
+ * Compare values are written to preload registers, timer copies them to active registers on update event.
+ * Update events are disabled while the registers are written, so all channels change in the same period.
+ * TIM4 is reset by update of TIM3, so PWM periods of both timers are the same.
+ * If phase staggering changes alignment of channels, all of them are written by interrupt at the next update.
+ */
+void pwm_set_channels(const uint16_t *values, uint32_t mask)
+{
+	stm32_tim_t *master = pwm_context.drivers[0]->tim;
+	uint32_t channel;
+	uint32_t timer;
+
+	chDbgAssert((mask & ((1U << PWM_DMA_CHANNELS) - 1U)) == 0, "channel of fade engine");
+	chSysLock();
+	for (channel = PWM_DMA_CHANNELS; channel < PWM_CHANNELS; channel++)
+	{
+		if (mask & (1U << channel))
+		{
+			pwm_context.duties[channel] = (values[channel] > PWM_PERIOD) ? PWM_PERIOD : values[channel];
+		}
+	}
+
+#if PWM_STAGGER == TRUE
+	pwm_context.pending_alignment = pwm_stagger();
+	if (pwm_context.pending_alignment != pwm_context.alignment)
+	{
+		pwmEnablePeriodicNotificationI(pwm_context.driver);
+		chSysUnlock();
+		return;
+	}
+#endif
+
+	/* Writing just before update could be split by it, so wait for the next period. */
+	while (master->CNT >= PWM_PERIOD - PWM_UPDATE_GUARD)
+	{
+	}
+	for (timer = 0; timer < PWM_TIMERS; timer++)
+	{
+		pwm_context.drivers[timer]->tim->CR1 |= STM32_TIM_CR1_UDIS;
+	}
+	for (channel = PWM_DMA_CHANNELS; channel < PWM_CHANNELS; channel++)
+	{
+		if (mask & (1U << channel))
+		{
+			pwm_channel_timer(channel)->CCR[channel % PWM_TIMER_CHANNELS] = pwm_channel_compare(channel, pwm_context.duties[channel]);
+		}
+	}
+	for (timer = PWM_TIMERS; timer > 0; timer--)
+	{
+		pwm_context.drivers[timer - 1]->tim->CR1 &= ~STM32_TIM_CR1_UDIS;
+	}
+	chSysUnlock();
 }
 
 void pwm_initialize(void)
 {
-	pwm_context.driver = &PWMD3;
-	pwm_context.config.callback = NULL;
-	pwm_context.config.frequency = 4000000; //* 4 MHz. */
-	pwm_context.config.period = 10000;      //* 200 Hz PWM frequency. */
+	static PWMDriver * const drivers[2] = { &PWMD3, &PWMD4 };
+	uint32_t timer;
+	uint32_t channel;
+
 	pwm_context.active_level = true;
 #if PWM_INVERTED == TRUE
 	pwm_context.active_level = !pwm_context.active_level;
 #endif
-	pwm_context.config.channels[0].mode = (PWM_INVERTED == TRUE) ? PWM_OUTPUT_ACTIVE_LOW : PWM_OUTPUT_ACTIVE_HIGH;
-	pwm_context.config.channels[0].callback = NULL;
-	pwm_context.config.channels[1].mode = PWM_OUTPUT_DISABLED;
-	pwm_context.config.channels[1].callback = NULL;
-	pwm_context.config.channels[2].mode = PWM_OUTPUT_DISABLED;
-	pwm_context.config.channels[2].callback = NULL;
-	pwm_context.config.channels[3].mode = PWM_OUTPUT_DISABLED;
-	pwm_context.config.channels[3].callback = NULL;
 
-	pwmStart(pwm_context.driver, &pwm_context.config);
-	pwmEnableChannel(pwm_context.driver, 0, 0);
-}
+	for (timer = 0; timer < PWM_TIMERS; timer++)
+	{
+		PWMConfig *config = &pwm_context.configs[timer];
+		pwm_context.drivers[timer] = drivers[timer];
+#if PWM_STAGGER == TRUE
+		config->callback = (timer == 0) ? pwm_period_callback : NULL;
+#else
+		config->callback = NULL;
+#endif
+		config->frequency = PWM_FREQUENCY;
+		config->period = PWM_PERIOD;
+		config->cr2 = (timer == 0) ? STM32_TIM_CR2_MMS(2) : 0; /** TIM3 trigger output is update. */
+		for (channel = 0; channel < PWM_TIMER_CHANNELS; channel++)
+		{
+			const bool used = (timer * PWM_TIMER_CHANNELS + channel) < PWM_CHANNELS;
+			config->channels[channel].mode = !used ? PWM_OUTPUT_DISABLED :
+			                                 (PWM_INVERTED == TRUE) ? PWM_OUTPUT_ACTIVE_LOW : PWM_OUTPUT_ACTIVE_HIGH;
+			config->channels[channel].callback = NULL;
+		}
+	}
+	pwm_context.driver = pwm_context.drivers[0];
 
+	/* Slave timers are started first and wait for reset by TIM3 (ITR2). */
+	for (timer = PWM_TIMERS; timer > 0; timer--)
+	{
+		pwmStart(pwm_context.drivers[timer - 1], &pwm_context.configs[timer - 1]);
+		if (timer > 1)
+		{
+			pwm_context.drivers[timer - 1]->tim->SMCR = STM32_TIM_SMCR_TS(2) | STM32_TIM_SMCR_SMS(4);
+		}
+	}
+	/* Channels start dark, back aligned ones in PWM mode 2 with compare value of period. */
+	for (channel = 0; channel < PWM_CHANNELS; channel++)
+	{
+#if PWM_STAGGER == TRUE
+		if (pwm_context.alignment & (1U << channel))
+		{
+			pwm_channel_mode(pwm_channel_timer(channel), channel % PWM_TIMER_CHANNELS, true);
+		}
+#endif
+		pwmEnableChannel(pwm_context.drivers[channel / PWM_TIMER_CHANNELS], channel % PWM_TIMER_CHANNELS,
+		                 pwm_channel_compare(channel, 0));
+		palSetPadMode(pwm_pins[channel].port, pwm_pins[channel].pin, PAL_MODE_STM32_ALTERNATE_PUSHPULL);
+	}
+}
@@ -0,0 +1,100 @@
+#include <hal.h>
+#include "ch.h"
+#include "storage.h"
+
+#define STORAGE_KEY1          0x45670123u
+#define STORAGE_KEY2          0xCDEF89ABu
+#define STORAGE_SR_ERRORS     (FLASH_SR_PGERR | FLASH_SR_WRPRTERR)
+
+/*
+ * Flash programming by FPEC registers.
+ * CPU stalls on any flash read while programming, so interrupts are delayed too:
+ * up to 40 ms for page erase and 70 us for halfword.
+ */
+static struct
+{
+	mutex_t lock;   /** FPEC is shared by all writers. */
+}storage_context;
+
+static void storage_unlock(void)
+{
+	if (FLASH->CR & FLASH_CR_LOCK)
+	{
+		FLASH->KEYR = STORAGE_KEY1;
+		FLASH->KEYR = STORAGE_KEY2;
+	}
+}
+
+static void storage_lock(void)
+{
+	FLASH->CR |= FLASH_CR_LOCK;
+}
+
+static bool storage_wait(void)
+{
+	uint32_t status;
+
+	while (FLASH->SR & FLASH_SR_BSY)
+	{
+	}
+	status = FLASH->SR;
+	FLASH->SR = FLASH_SR_EOP | STORAGE_SR_ERRORS; /** Flags are cleared by writing one. */
+	return (status & STORAGE_SR_ERRORS) == 0;
+}
+
+void storage_initialize(void)
+{
+	chMtxObjectInit(&storage_context.lock);
+}
+
+bool storage_erase(uint32_t address)
+{
+	bool result;
+	const uint32_t *word = (const uint32_t *)(uintptr_t)address;
+	size_t i;
+
+	chMtxLock(&storage_context.lock);
+	storage_unlock();
+	FLASH->CR |= FLASH_CR_PER;
+	FLASH->AR = address;
+	FLASH->CR |= FLASH_CR_STRT;
+	result = storage_wait();
+	FLASH->CR &= ~FLASH_CR_PER;
+	storage_lock();
+	chMtxUnlock(&storage_context.lock);
+
+	for (i = 0; result && (i < STORAGE_PAGE_SIZE / sizeof(uint32_t)); i++)
+	{
+		result = (word[i] == 0xFFFFFFFFu);
+	}
+	return result;
+}
+
+bool storage_write(uint32_t address, const void *data, size_t size)
+{
+	const uint8_t *bytes = (const uint8_t *)data;
+	volatile uint16_t *target = (volatile uint16_t *)(uintptr_t)address;
+	bool result = ((address & 1u) == 0);
+	size_t i;
+
+	chMtxLock(&storage_context.lock);
+	storage_unlock();
+	FLASH->CR |= FLASH_CR_PG;
+	for (i = 0; result && (i < size); i += 2)
+	{
+		uint16_t halfword = bytes[i];
+		halfword |= (uint16_t)(((i + 1) < size) ? bytes[i + 1] : 0xFFu) << 8; /** Odd tail is padded as erased. */
+		*target = halfword;
+		result = storage_wait() && (*target == halfword);
+		target++;
+	}
+	FLASH->CR &= ~FLASH_CR_PG;
+	storage_lock();
+	chMtxUnlock(&storage_context.lock);
+	return result;
+}
+
+const void *storage_pointer(uint32_t address)
+{
+	return (const void *)(uintptr_t)address;
+}
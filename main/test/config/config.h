@@ -0,0 +1,23 @@
+#ifndef TEST_CONFIG_H
+#define TEST_CONFIG_H
+
+/* Firmware configuration with all infrared protocols and all PWM channels, so host tests cover every decoder and channel. */
+#include "../../h/config.h"
+
+#undef IR_USE_NEC
+#undef IR_USE_RC5
+#undef IR_USE_RC6
+#undef IR_USE_SIRC
+#undef IR_USE_SAMSUNG32
+#define IR_USE_NEC        TRUE
+#define IR_USE_RC5        TRUE
+#define IR_USE_RC6        TRUE
+#define IR_USE_SIRC       TRUE
+#define IR_USE_SAMSUNG32  TRUE
+
+#undef PWM_CHANNELS
+#undef COLOUR_TUNABLE_WHITE
+#define PWM_CHANNELS      8U
+#define COLOUR_TUNABLE_WHITE TRUE
+
+#endif //TEST_CONFIG_H
@@ -0,0 +1,177 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "shim.h"
+#include "pwm.h"
+#include "fade.h"
+#include "config.h"
+
+/*
+ * Simulation of fade engine of fade.c at steady level: DMA interrupts must stop when level is reached,
+ * and the repeated buffer must keep exact average duty of sigma-delta dithering and its lowest pulse rate.
+ * Every brightness level is faded to, with gains changed now and then, and run for a window of updates.
+ * Fails if done event is missing, if any level keeps interrupts, or if a repeated buffer has long gap or wrong duty:
+ * only the lowest values may be brighter, raised to whole pulses per buffer. Reports number of them and the largest raise.
+ */
+
+#define FADE_QUIET_WINDOW       256u    /** Updates, a multiple of DMA buffer of any profile. */
+#define FADE_QUIET_SETTLE       1024u   /** Updates until level is reached and interrupts stop. */
+#define FADE_QUIET_REFERENCE    16384u  /** Periods of reference dithering. */
+#define FADE_QUIET_GAINS_EVERY  64u     /** Levels between changes of gains. */
+#define FADE_QUIET_RATE_MIN     200u    /** Pulses per second, slower ones flicker. */
+#define FADE_QUIET_PERIODS_PER_SEC (PWM_FREQUENCY / PWM_PERIOD)
+
+static struct
+{
+	uint32_t              gains[PWM_DMA_CHANNELS];
+	uint32_t              errors;
+}fade_quiet_context;
+
+static void fade_quiet_error(const char *reason, uint32_t level, uint32_t channel, uint64_t value, uint64_t expected)
+{
+	if (fade_quiet_context.errors < 10u)
+	{
+		printf("%s: level %u channel %u is %llu, expected %llu\n", reason, (unsigned)level, (unsigned)channel,
+		       (unsigned long long)value, (unsigned long long)expected);
+	}
+	fade_quiet_context.errors++;
+}
+
+/* Average compare value of steady dithering, 1/16 ticks, rounded. */
+static uint64_t fade_quiet_reference(uint16_t level, uint32_t channel)
+{
+	const uint32_t scaled = (uint32_t)(((uint64_t)pwm_level_ticks(level) * fade_quiet_context.gains[channel]) >> 16);
+	uint64_t sum = 0;
+	int32_t error = 0;
+	uint32_t period;
+
+	for (period = 0; period < FADE_QUIET_REFERENCE; period++)
+	{
+		sum += (uint64_t)pwm_quantize(&error, scaled) << PWM_FRACTION_BITS;
+	}
+	return (sum + FADE_QUIET_REFERENCE / 2u) / FADE_QUIET_REFERENCE;
+}
+
+/* Duty of active compare value, back aligned channels are on from period - duty. */
+static uint32_t fade_quiet_duty(uint32_t channel)
+{
+	const uint32_t compare = PWMD3.active[channel];
+
+	return (PWM_DMA_BACK_CHANNELS & (1u << channel)) ? PWM_PERIOD - compare : compare;
+}
+
+static void fade_quiet_run(uint32_t updates, uint32_t (*duties)[PWM_DMA_CHANNELS])
+{
+	uint32_t channel;
+	uint32_t i;
+
+	for (i = 0; i < updates; i++)
+	{
+		shim_pwm_update(&PWMD3);
+		for (channel = 0; (duties != NULL) && (channel < PWM_DMA_CHANNELS); channel++)
+		{
+			duties[i][channel] = fade_quiet_duty(channel);
+		}
+	}
+}
+
+/* Window is repeated, so the longest run of dark periods may wrap around its end. */
+static uint32_t fade_quiet_gap(uint32_t (*duties)[PWM_DMA_CHANNELS], uint32_t channel)
+{
+	uint32_t gap = 0;
+	uint32_t gap_max = 0;
+	uint32_t i;
+
+	for (i = 0; i < 2u * FADE_QUIET_WINDOW; i++)
+	{
+		gap = (duties[i % FADE_QUIET_WINDOW][channel] == 0) ? gap + 1u : 0;
+		gap_max = (gap > gap_max) ? gap : gap_max;
+	}
+	return gap_max;
+}
+
+int main(void)
+{
+	shim_statistics_t statistics;
+	static uint32_t duties[FADE_QUIET_WINDOW][PWM_DMA_CHANNELS];
+	uint32_t gap_max = 0;
+	uint32_t raised = 0;
+	uint64_t raise_max = 0;
+	uint32_t quiet = 0;
+	uint32_t level;
+
+	pwm_initialize();
+	fade_initialize();
+
+	for (level = 0; level <= PWM_LEVEL_MAX; level++)
+	{
+		uint32_t channel;
+
+		if (level % FADE_QUIET_GAINS_EVERY == 0)
+		{
+			for (channel = 0; channel < PWM_DMA_CHANNELS; channel++)
+			{
+				fade_quiet_context.gains[channel] = FADE_GAIN_ONE - (uint32_t)rand() % (FADE_GAIN_ONE / 2u);
+			}
+			fade_set_gains(fade_quiet_context.gains);
+		}
+		fade_event_source()->flags = 0;
+		fade_to((uint16_t)level, 0, FADE_LINEAR);
+		fade_quiet_run(FADE_QUIET_SETTLE, NULL);
+		if ((fade_event_source()->flags & FADE_EVENT_DONE) == 0)
+		{
+			fade_quiet_error("done event", level, 0, 0, 1);
+		}
+
+		shim_reset_statistics();
+		fade_quiet_run(FADE_QUIET_WINDOW, duties);
+		shim_get_statistics(&statistics);
+		if (statistics.dma_interrupts != 0)
+		{
+			fade_quiet_error("interrupts", level, 0, statistics.dma_interrupts, 0);
+			continue;
+		}
+		quiet++;
+		for (channel = 0; channel < PWM_DMA_CHANNELS; channel++)
+		{
+			const uint64_t expected = fade_quiet_reference((uint16_t)level, channel) * FADE_QUIET_WINDOW;
+			uint64_t sum = 0;
+			uint32_t gap;
+			uint32_t i;
+
+			for (i = 0; i < FADE_QUIET_WINDOW; i++)
+			{
+				sum += (uint64_t)duties[i][channel] << PWM_FRACTION_BITS;
+			}
+			if (sum < expected)
+			{
+				fade_quiet_error("window duty, 1/16 ticks", level, channel, sum, expected);
+			}
+			else if (sum > expected)
+			{
+				raised++;
+				raise_max = (sum - expected > raise_max) ? sum - expected : raise_max;
+			}
+			if (expected == 0)
+			{
+				continue;
+			}
+			gap = fade_quiet_gap(duties, channel);
+			gap_max = (gap > gap_max) ? gap : gap_max;
+			if ((gap + 1u) * FADE_QUIET_RATE_MIN > FADE_QUIET_PERIODS_PER_SEC)
+			{
+				fade_quiet_error("dark periods", level, channel, gap, FADE_QUIET_PERIODS_PER_SEC / FADE_QUIET_RATE_MIN - 1u);
+			}
+		}
+	}
+
+	printf("%u of %u levels quiet at %u Hz, longest gap between pulses %u periods\n", (unsigned)quiet,
+	       (unsigned)(PWM_LEVEL_MAX + 1u), (unsigned)FADE_QUIET_PERIODS_PER_SEC, (unsigned)gap_max);
+	printf("%u channel levels raised to whole pulses, by %.3f ticks at most\n", (unsigned)raised,
+	       (double)raise_max / (double)(FADE_QUIET_WINDOW << PWM_FRACTION_BITS));
+	if (fade_quiet_context.errors != 0)
+	{
+		printf("FAILED: %u errors\n", (unsigned)fade_quiet_context.errors);
+		return 1;
+	}
+	return 0;
+}
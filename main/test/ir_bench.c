@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "shim.h"
+#include "ir_protocol.h"
+
+/*
+ * Cycles per decoded NEC frame: bitmap decoding of oversampling receiver and pulse distance decoder of ir_nec.c.
+ * Old path is fed with 96 measured levels of one frame, as its timer interrupt pushed them,
+ * new one with 66 pulses and spaces, as decoder thread gets them. Interrupts are not included, see ir_compare.
+ * Frames are timed in batches and the fastest batch is reported, slower ones were disturbed by host.
+ */
+#include "baseline/ir_oversampling.c"
+
+#define IR_BENCH_FRAMES         200000u
+#define IR_BENCH_BATCHES        50u
+#define IR_BENCH_BATCH_FRAMES   (IR_BENCH_FRAMES / IR_BENCH_BATCHES)
+#define IR_BENCH_ADDRESS        0x1234u
+#define IR_BENCH_COMMAND        0x5au
+
+static uint32_t ir_bench_received;
+
+static void ir_bench_callback(void *context, uint16_t address, uint8_t command, bool repeat)
+{
+	(void)context;
+	(void)repeat;
+	if ((address == IR_BENCH_ADDRESS) && (command == IR_BENCH_COMMAND))
+	{
+		ir_bench_received++;
+	}
+}
+
+static uint32_t ir_bench_data(void)
+{
+	return IR_BENCH_ADDRESS | ((uint32_t)IR_BENCH_COMMAND << 16) | ((uint32_t)(uint8_t)~IR_BENCH_COMMAND << 24);
+}
+
+static double ir_bench_old(void)
+{
+	bool levels[IR_NUMBER_OF_BITS_PER_COMMAND];
+	const uint32_t data = ir_bench_data();
+	uint32_t count = 0;
+	uint32_t batch;
+	uint32_t frame;
+	uint32_t bit;
+	rtcnt_t best = (rtcnt_t)-1;
+
+	/* Logic zero is pulse and space of one measure, logic one is pulse and space of three measures, then stop pulse. */
+	for (bit = 0; bit < 32u; bit++)
+	{
+		levels[count++] = true;
+		levels[count++] = false;
+		if (data & (1u << bit))
+		{
+			levels[count++] = false;
+			levels[count++] = false;
+		}
+	}
+	levels[count++] = true;
+	while (count < IR_NUMBER_OF_BITS_PER_COMMAND)
+	{
+		levels[count++] = false;
+	}
+
+	ir_context.decoder.callback = ir_bench_callback;
+	for (batch = 0; batch < IR_BENCH_BATCHES; batch++)
+	{
+		const rtcnt_t start = chSysGetRealtimeCounterX();
+		rtcnt_t cycles;
+		for (frame = 0; frame < IR_BENCH_BATCH_FRAMES; frame++)
+		{
+			for (bit = 0; bit < IR_NUMBER_OF_BITS_PER_COMMAND; bit++)
+			{
+				ir_push_signal_value(levels[bit], (uint8_t)bit);
+			}
+		}
+		cycles = (rtcnt_t)(chSysGetRealtimeCounterX() - start);
+		best = (cycles < best) ? cycles : best;
+	}
+	return (double)best / IR_BENCH_BATCH_FRAMES;
+}
+
+static double ir_bench_new(void)
+{
+	uint32_t durations[2u + 64u + 2u];
+	const uint32_t data = ir_bench_data();
+	uint32_t count = 0;
+	uint32_t batch;
+	uint32_t frame;
+	uint32_t i;
+	uint32_t now = 0;
+	rtcnt_t best = (rtcnt_t)-1;
+
+	durations[count++] = IR_USEC(9000u);
+	durations[count++] = IR_USEC(4500u);
+	for (i = 0; i < 32u; i++)
+	{
+		durations[count++] = IR_USEC(562u);
+		durations[count++] = IR_USEC((data & (1u << i)) ? 1687u : 562u);
+	}
+	durations[count++] = IR_USEC(562u);
+	durations[count++] = IR_USEC(40000u);
+
+	for (batch = 0; batch < IR_BENCH_BATCHES; batch++)
+	{
+		const rtcnt_t start = chSysGetRealtimeCounterX();
+		rtcnt_t cycles;
+		for (frame = 0; frame < IR_BENCH_BATCH_FRAMES; frame++)
+		{
+			for (i = 0; i < count; i++)
+			{
+				ir_frame_t received;
+				now += durations[i];
+				if (ir_nec_decode((i % 2u) == 0, durations[i], now & IR_EDGE_TIME_MASK, &received) &&
+				    (received.address == IR_BENCH_ADDRESS) && (received.command == IR_BENCH_COMMAND))
+				{
+					ir_bench_received++;
+				}
+			}
+		}
+		cycles = (rtcnt_t)(chSysGetRealtimeCounterX() - start);
+		best = (cycles < best) ? cycles : best;
+	}
+	return (double)best / IR_BENCH_BATCH_FRAMES;
+}
+
+int main(void)
+{
+	double old_cycles;
+	double new_cycles;
+
+	ir_bench_received = 0;
+	old_cycles = ir_bench_old();
+	printf("bitmap decoding:         %6.0f host cycles per frame, %u of %u frames received\n",
+	       old_cycles, (unsigned)ir_bench_received, (unsigned)IR_BENCH_FRAMES);
+	if (ir_bench_received != IR_BENCH_FRAMES)
+	{
+		printf("FAILED: bitmap decoding lost frames\n");
+		return 1;
+	}
+
+	ir_bench_received = 0;
+	new_cycles = ir_bench_new();
+	printf("pulse distance decoding: %6.0f host cycles per frame, %u of %u frames received\n",
+	       new_cycles, (unsigned)ir_bench_received, (unsigned)IR_BENCH_FRAMES);
+	if (ir_bench_received != IR_BENCH_FRAMES)
+	{
+		printf("FAILED: pulse distance decoding lost frames\n");
+		return 1;
+	}
+	printf("ratio %.1f\n", old_cycles / new_cycles);
+	return 0;
+}
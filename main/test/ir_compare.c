@@ -0,0 +1,188 @@
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "shim.h"
+#include "ir.h"
+#include "replay.h"
+
+/*
+ * Comparison of edge timestamping receiver of ir.c with oversampling receiver it replaced, NEC only.
+ * Both receivers get the same frames with the same injected errors, one after another on the same pin,
+ * and received commands of every frame must be the same. Frames lost by oversampling receiver only are counted
+ * apart, edge timestamps are not sampled in the middle of bit, so they stand more jitter.
+ * Interrupts per frame are reported for both.
+ */
+
+#define IR_COMPARE_FRAMES_MAX   4096u
+#define IR_COMPARE_REPORTS_MAX  2u
+
+void ir_baseline_initialize(void);
+void ir_baseline_set_callback(ir_command_callback_t *callback, void *context);
+
+typedef struct
+{
+	ir_frame_t            received[IR_COMPARE_REPORTS_MAX];
+	uint32_t              count;
+}ir_compare_frame_t;
+
+static struct
+{
+	replay_frame_t        frames[IR_COMPARE_FRAMES_MAX / 8u];
+	ir_compare_frame_t    results[2][IR_COMPARE_FRAMES_MAX];
+	uint32_t              receiver;       /** Index of receiver being replayed. */
+	size_t                offset;         /** Index of first frame of current round. */
+}ir_compare_context;
+
+static void ir_compare_baseline_callback(void *context, uint16_t address, uint8_t command, bool repeat)
+{
+	(void)context;
+	replay_report(IR_PROTOCOL_NEC, address, command, repeat);
+}
+
+static void ir_compare_callback(void *context, ir_protocol_t protocol, uint16_t address, uint8_t command, bool repeat)
+{
+	(void)context;
+	replay_report(protocol, address, command, repeat);
+}
+
+static void ir_compare_frame(size_t index, const ir_frame_t *received, uint32_t count)
+{
+	ir_compare_frame_t *result = &ir_compare_context.results[ir_compare_context.receiver][ir_compare_context.offset + index];
+
+	result->count = count;
+	memcpy(result->received, received, sizeof(ir_frame_t) * ((count < IR_COMPARE_REPORTS_MAX) ? count : IR_COMPARE_REPORTS_MAX));
+}
+
+static bool ir_compare_equal(const ir_compare_frame_t *a, const ir_compare_frame_t *b)
+{
+	uint32_t i;
+
+	if (a->count != b->count)
+	{
+		return false;
+	}
+	for (i = 0; (i < a->count) && (i < IR_COMPARE_REPORTS_MAX); i++)
+	{
+		if ((a->received[i].protocol != b->received[i].protocol) || (a->received[i].address != b->received[i].address) ||
+		    (a->received[i].command != b->received[i].command) || (a->received[i].repeat != b->received[i].repeat))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+static void ir_compare_run(uint32_t receiver, size_t count, uint32_t rounds, replay_options_t options)
+{
+	const uint32_t seed = options.seed;
+	replay_result_t result = {0};
+	shim_statistics_t interrupts;
+	uint32_t round;
+
+	ir_compare_context.receiver = receiver;
+	shim_reset_statistics();
+	for (round = 0; round < rounds; round++)
+	{
+		options.seed = seed + round;
+		ir_compare_context.offset = round * count;
+		replay_run(ir_compare_context.frames, count, &options, &result);
+	}
+	shim_get_statistics(&interrupts);
+	printf("%-12s received %u of %u, wrong repeat flag %u, false %u, interrupts per frame %.1f\n",
+	       (receiver == 0) ? "oversampling" : "edges",
+	       (unsigned)result.received, (unsigned)result.frames, (unsigned)result.repeat_errors,
+	       (unsigned)result.false_positives,
+	       (double)(interrupts.pad_interrupts + interrupts.timer_interrupts) / (result.frames + result.noise));
+}
+
+static void ir_compare_usage(void)
+{
+	fprintf(stderr,
+	        "Usage: ir_compare [options] trace...\n"
+	        "  -r rounds      plays of every trace, 1 by default\n"
+	        "  -j usec        jitter of edges, both directions\n"
+	        "  -s permille    clock skew of remote, may be negative\n"
+	        "  -S seed        seed of random errors\n"
+	        "  -d frames      fail if results of more frames differ, 0 by default\n");
+	exit(2);
+}
+
+int main(int argc, char *argv[])
+{
+	replay_options_t options = {.seed = 1, .frame_callback = ir_compare_frame};
+	uint32_t max_differences = 0;
+	uint32_t differences = 0;
+	uint32_t recovered = 0;
+	uint32_t rounds = 1;
+	size_t count = 0;
+	size_t i;
+	int option;
+
+	while ((option = getopt(argc, argv, "r:j:s:S:d:")) != -1)
+	{
+		switch (option)
+		{
+			case 'r': rounds = (uint32_t)strtoul(optarg, NULL, 0); break;
+			case 'j': options.jitter_usec = (uint32_t)strtoul(optarg, NULL, 0); break;
+			case 's': options.skew_permille = (int32_t)strtol(optarg, NULL, 0); break;
+			case 'S': options.seed = (uint32_t)strtoul(optarg, NULL, 0); break;
+			case 'd': max_differences = (uint32_t)strtoul(optarg, NULL, 0); break;
+			default: ir_compare_usage();
+		}
+	}
+	if (optind >= argc)
+	{
+		ir_compare_usage();
+	}
+	for (; optind < argc; optind++)
+	{
+		count += replay_load(argv[optind], &ir_compare_context.frames[count],
+		                     sizeof(ir_compare_context.frames) / sizeof(ir_compare_context.frames[0]) - count);
+	}
+	if ((rounds == 0) || (count * rounds > IR_COMPARE_FRAMES_MAX))
+	{
+		fprintf(stderr, "too many frames\n");
+		return 2;
+	}
+
+	/* Receivers share the pin and TIM1, the second one takes them over at initialization. */
+	ir_baseline_initialize();
+	ir_baseline_set_callback(ir_compare_baseline_callback, NULL);
+	ir_compare_run(0, count, rounds, options);
+	ir_initialize();
+	ir_set_frame_callback(ir_compare_callback, NULL);
+	ir_compare_run(1, count, rounds, options);
+
+	for (i = 0; i < count * rounds; i++)
+	{
+		const replay_frame_t *frame = &ir_compare_context.frames[i % count];
+		const ir_frame_t *received = &ir_compare_context.results[1][i].received[0];
+
+		if ((ir_compare_context.results[0][i].count == 0) && (ir_compare_context.results[1][i].count == 1) &&
+		    (received->protocol == frame->protocol) && (received->address == frame->address) &&
+		    (received->command == frame->command))
+		{
+			recovered++;
+		}
+		else if (!ir_compare_equal(&ir_compare_context.results[0][i], &ir_compare_context.results[1][i]))
+		{
+			if (differences < 10u)
+			{
+				printf("round %u frame %u (%s 0x%04x 0x%02x %u): %u and %u received\n",
+				       (unsigned)(i / count), (unsigned)(i % count), replay_protocol_name(frame->protocol),
+				       frame->address, frame->command, frame->repeat,
+				       (unsigned)ir_compare_context.results[0][i].count, (unsigned)ir_compare_context.results[1][i].count);
+			}
+			differences++;
+		}
+	}
+	printf("%u of %u frames differ, %u more are received by edges only\n",
+	       (unsigned)differences, (unsigned)(count * rounds), (unsigned)recovered);
+	if (differences > max_differences)
+	{
+		printf("FAILED: more than %u frames differ\n", (unsigned)max_differences);
+		return 1;
+	}
+	return 0;
+}
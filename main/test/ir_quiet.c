@@ -0,0 +1,104 @@
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "shim.h"
+#include "ir.h"
+#include "replay.h"
+
+/*
+ * Idle wakeups of receiver: GPT timer of ir.c must stop when signal is quiet and start again by the next edge.
+ * Every trace is played, then signal is quiet for -q seconds, which are counted separately.
+ * Fails if a frame is lost or false, if timer interrupts come while signal is quiet,
+ * or if kernel time stamp refresh wakes MCU more than once per IR_QUIET_STAMP_MSEC.
+ */
+
+#define IR_QUIET_FRAMES_MAX     128u
+#define IR_QUIET_SETTLE_MSEC    200u    /** Quiet signal before timer is stopped, longer than IR_QUIET_USEC of ir.c. */
+#define IR_QUIET_STAMP_MSEC     4000u   /** Longest refresh period of kernel time stamp, ir.c refreshes it as rarely. */
+
+static void ir_quiet_callback(void *context, ir_protocol_t protocol, uint16_t address, uint8_t command, bool repeat)
+{
+	(void)context;
+	replay_report(protocol, address, command, repeat);
+}
+
+static void ir_quiet_usage(void)
+{
+	fprintf(stderr,
+	        "Usage: ir_quiet [options] trace...\n"
+	        "  -r rounds      plays of every trace, 1 by default\n"
+	        "  -j usec        jitter of edges, both directions\n"
+	        "  -q seconds     quiet signal after every trace, 60 by default\n");
+	exit(2);
+}
+
+int main(int argc, char *argv[])
+{
+	static replay_frame_t frames[IR_QUIET_FRAMES_MAX];
+	replay_options_t options = {.seed = 1};
+	replay_result_t result = {0};
+	shim_statistics_t statistics;
+	uint64_t active_timer = 0;
+	uint64_t quiet_timer = 0;
+	uint64_t quiet_kernel = 0;
+	uint64_t quiet_msec = 0;
+	uint32_t quiet_sec = 60;
+	uint32_t rounds = 1;
+	uint32_t round;
+	int option;
+	int first;
+
+	while ((option = getopt(argc, argv, "r:j:q:")) != -1)
+	{
+		switch (option)
+		{
+			case 'r': rounds = (uint32_t)strtoul(optarg, NULL, 0); break;
+			case 'j': options.jitter_usec = (uint32_t)strtoul(optarg, NULL, 0); break;
+			case 'q': quiet_sec = (uint32_t)strtoul(optarg, NULL, 0); break;
+			default: ir_quiet_usage();
+		}
+	}
+	if (optind >= argc)
+	{
+		ir_quiet_usage();
+	}
+	first = optind;
+
+	ir_initialize();
+	ir_set_frame_callback(ir_quiet_callback, NULL);
+
+	for (round = 0; round < rounds; round++)
+	{
+		for (optind = first; optind < argc; optind++)
+		{
+			const size_t count = replay_load(argv[optind], frames, IR_QUIET_FRAMES_MAX);
+
+			options.seed = round + 1u;
+			shim_reset_statistics();
+			replay_run(frames, count, &options, &result);
+			shim_advance((uint64_t)IR_QUIET_SETTLE_MSEC * SHIM_NSEC_PER_MSEC);
+			shim_get_statistics(&statistics);
+			active_timer += statistics.timer_interrupts;
+
+			shim_reset_statistics();
+			shim_advance((uint64_t)quiet_sec * 1000u * SHIM_NSEC_PER_MSEC);
+			shim_get_statistics(&statistics);
+			quiet_timer += statistics.timer_interrupts;
+			quiet_kernel += statistics.kernel_interrupts;
+			quiet_msec += (uint64_t)quiet_sec * 1000u;
+		}
+	}
+
+	printf("received %u of %u frames, false %u, %u timer interrupts while signal changes\n", (unsigned)result.received,
+	       (unsigned)result.frames, (unsigned)result.false_positives, (unsigned)active_timer);
+	printf("quiet %.0f s: timer interrupts %u, kernel time stamp refreshes %u, %.3f wakeups per second\n",
+	       (double)quiet_msec / 1000.0, (unsigned)quiet_timer, (unsigned)quiet_kernel,
+	       (double)(quiet_timer + quiet_kernel) * 1000.0 / (double)quiet_msec);
+	if ((result.received != result.frames) || (result.false_positives != 0) || (quiet_timer != 0) ||
+	    (quiet_kernel > quiet_msec / IR_QUIET_STAMP_MSEC))
+	{
+		printf("FAILED: frames were lost or receiver was not quiet\n");
+		return 1;
+	}
+	return 0;
+}
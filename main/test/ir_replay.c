@@ -0,0 +1,119 @@
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "shim.h"
+#include "ir.h"
+#include "replay.h"
+
+/*
+ * Replay of trace files through ir.c and enabled decoders, with injected receiver and remote errors.
+ * Reports rate of received frames, rate of false frames and cost of handlers per signal change.
+ * Exits with failure if rates are worse than limits given by options, so it is used by "make check".
+ */
+
+#define IR_REPLAY_FRAMES_MAX    512u
+
+static replay_frame_t ir_replay_frames[IR_REPLAY_FRAMES_MAX];
+
+static void ir_replay_callback(void *context, ir_protocol_t protocol, uint16_t address, uint8_t command, bool repeat)
+{
+	(void)context;
+	replay_report(protocol, address, command, repeat);
+}
+
+static void ir_replay_usage(void)
+{
+	fprintf(stderr,
+	        "Usage: ir_replay [options] trace...\n"
+	        "  -r rounds      plays of every trace, 1 by default\n"
+	        "  -j usec        jitter of edges, both directions\n"
+	        "  -g permille    probability of glitch per frame\n"
+	        "  -G usec        duration of glitch, 50 by default\n"
+	        "  -s permille    clock skew of remote, may be negative\n"
+	        "  -d permille    drift of clock skew within frame, may be negative\n"
+	        "  -S seed        seed of random errors\n"
+	        "  -m percent     fail if less frames are received\n"
+	        "  -f permille    fail if more false frames are received, per played frame\n");
+	exit(2);
+}
+
+int main(int argc, char *argv[])
+{
+	replay_options_t options = {.glitch_usec = 50, .seed = 1};
+	replay_result_t result = {0};
+	ir_statistics_t statistics;
+	shim_statistics_t interrupts;
+	double min_received_percent = 0;
+	double max_false_permille = 1000;
+	double received_percent;
+	double false_permille;
+	size_t count = 0;
+	uint32_t seed;
+	uint32_t rounds = 1;
+	uint32_t round;
+	int option;
+
+	while ((option = getopt(argc, argv, "r:j:g:G:s:d:S:m:f:")) != -1)
+	{
+		switch (option)
+		{
+			case 'r': rounds = (uint32_t)strtoul(optarg, NULL, 0); break;
+			case 'j': options.jitter_usec = (uint32_t)strtoul(optarg, NULL, 0); break;
+			case 'g': options.glitch_permille = (uint32_t)strtoul(optarg, NULL, 0); break;
+			case 'G': options.glitch_usec = (uint32_t)strtoul(optarg, NULL, 0); break;
+			case 's': options.skew_permille = (int32_t)strtol(optarg, NULL, 0); break;
+			case 'd': options.drift_permille = (int32_t)strtol(optarg, NULL, 0); break;
+			case 'S': options.seed = (uint32_t)strtoul(optarg, NULL, 0); break;
+			case 'm': min_received_percent = strtod(optarg, NULL); break;
+			case 'f': max_false_permille = strtod(optarg, NULL); break;
+			default: ir_replay_usage();
+		}
+	}
+	if (optind >= argc)
+	{
+		ir_replay_usage();
+	}
+	for (; optind < argc; optind++)
+	{
+		count += replay_load(argv[optind], &ir_replay_frames[count], IR_REPLAY_FRAMES_MAX - count);
+	}
+
+	ir_initialize();
+	ir_set_frame_callback(ir_replay_callback, NULL);
+	seed = options.seed;
+	for (round = 0; round < rounds; round++)
+	{
+		options.seed = seed + round;
+		replay_run(ir_replay_frames, count, &options, &result);
+	}
+
+	ir_get_statistics(&statistics);
+	shim_get_statistics(&interrupts);
+	received_percent = (result.frames != 0) ? 100.0 * result.received / result.frames : 100.0;
+	false_permille = 1000.0 * result.false_positives / (result.frames + result.noise);
+
+	printf("frames %u x %u rounds, noise %u, jitter %u us, glitches %u permille of %u us, skew %d permille, drift %d permille\n",
+	       (unsigned)(result.frames / rounds), (unsigned)rounds, (unsigned)(result.noise / rounds),
+	       (unsigned)options.jitter_usec, (unsigned)options.glitch_permille, (unsigned)options.glitch_usec,
+	       (int)options.skew_permille, (int)options.drift_permille);
+	printf("received %u of %u (%.1f %%), wrong repeat flag %u, false %u (%.1f permille)\n",
+	       (unsigned)result.received, (unsigned)result.frames, received_percent,
+	       (unsigned)result.repeat_errors, (unsigned)result.false_positives, false_permille);
+	printf("edge interrupt %.0f, timer interrupt %.0f, decoding %.0f (max %u) host cycles per call\n",
+	       (double)interrupts.pad_cycles / (interrupts.pad_interrupts ? interrupts.pad_interrupts : 1u),
+	       (double)interrupts.timer_cycles / (interrupts.timer_interrupts ? interrupts.timer_interrupts : 1u),
+	       (double)statistics.decode_cycles_total / (statistics.edges ? statistics.edges : 1u),
+	       (unsigned)statistics.decode_cycles_max);
+	printf("edges %u, interrupts per edge %.2f, dropped %u, storms %u\n",
+	       (unsigned)result.edges,
+	       (double)(interrupts.pad_interrupts + interrupts.timer_interrupts) / (result.edges ? result.edges : 1u),
+	       (unsigned)statistics.dropped_edges, (unsigned)statistics.storms);
+
+	if ((received_percent < min_received_percent) || (false_permille > max_false_permille))
+	{
+		printf("FAILED: received less than %.1f %% or false more than %.1f permille\n",
+		       min_received_percent, max_false_permille);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,139 @@
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "shim.h"
+#include "ir.h"
+#include "replay.h"
+
+/*
+ * Sweep of remote clock skew through oversampling receiver which ir.c replaced, and through ir.c.
+ * Oversampling receiver measures bit period once by leading pulse, ir.c tracks it on every bit,
+ * so clock drift within frame is swept too. Prints rate of received frames per skew of both receivers.
+ * Fails if ir.c receives less frames than limit within the skew range given by options.
+ */
+
+#define IR_SKEW_FRAMES_MAX      64u
+#define IR_SKEW_STEP_PERMILLE   25
+#define IR_SKEW_MAX_PERMILLE    200
+#define IR_SKEW_POINTS          (2u * IR_SKEW_MAX_PERMILLE / IR_SKEW_STEP_PERMILLE + 1u)
+
+void ir_baseline_initialize(void);
+void ir_baseline_set_callback(ir_command_callback_t *callback, void *context);
+
+static struct
+{
+	replay_frame_t        frames[IR_SKEW_FRAMES_MAX];
+	double                received[2][IR_SKEW_POINTS];    /** Percent of received frames per receiver and skew. */
+}ir_skew_context;
+
+static void ir_skew_baseline_callback(void *context, uint16_t address, uint8_t command, bool repeat)
+{
+	(void)context;
+	replay_report(IR_PROTOCOL_NEC, address, command, repeat);
+}
+
+static void ir_skew_callback(void *context, ir_protocol_t protocol, uint16_t address, uint8_t command, bool repeat)
+{
+	(void)context;
+	replay_report(protocol, address, command, repeat);
+}
+
+static int32_t ir_skew_point(uint32_t point)
+{
+	return (int32_t)point * IR_SKEW_STEP_PERMILLE - IR_SKEW_MAX_PERMILLE;
+}
+
+static void ir_skew_run(uint32_t receiver, size_t count, uint32_t rounds, replay_options_t options)
+{
+	const uint32_t seed = options.seed;
+	uint32_t point;
+
+	for (point = 0; point < IR_SKEW_POINTS; point++)
+	{
+		replay_result_t result = {0};
+		uint32_t round;
+
+		/* Drift is centered at skew point. */
+		options.skew_permille = ir_skew_point(point) - options.drift_permille / 2;
+		for (round = 0; round < rounds; round++)
+		{
+			options.seed = seed + round;
+			replay_run(ir_skew_context.frames, count, &options, &result);
+		}
+		ir_skew_context.received[receiver][point] = (result.frames != 0) ? 100.0 * result.received / result.frames : 100.0;
+	}
+}
+
+static void ir_skew_usage(void)
+{
+	fprintf(stderr,
+	        "Usage: ir_skew [options] trace...\n"
+	        "  -r rounds      plays of every trace per skew, 1 by default\n"
+	        "  -j usec        jitter of edges, both directions\n"
+	        "  -d permille    drift of clock skew within frame, may be negative\n"
+	        "  -S seed        seed of random errors\n"
+	        "  -w permille    skew range checked by -m, both directions, 0 by default\n"
+	        "  -m percent     fail if ir.c receives less frames within skew range\n");
+	exit(2);
+}
+
+int main(int argc, char *argv[])
+{
+	replay_options_t options = {.seed = 1};
+	double min_received_percent = 0;
+	int32_t range_permille = 0;
+	uint32_t rounds = 1;
+	uint32_t point;
+	size_t count = 0;
+	bool failed = false;
+	int option;
+
+	while ((option = getopt(argc, argv, "r:j:d:S:w:m:")) != -1)
+	{
+		switch (option)
+		{
+			case 'r': rounds = (uint32_t)strtoul(optarg, NULL, 0); break;
+			case 'j': options.jitter_usec = (uint32_t)strtoul(optarg, NULL, 0); break;
+			case 'd': options.drift_permille = (int32_t)strtol(optarg, NULL, 0); break;
+			case 'S': options.seed = (uint32_t)strtoul(optarg, NULL, 0); break;
+			case 'w': range_permille = (int32_t)strtol(optarg, NULL, 0); break;
+			case 'm': min_received_percent = strtod(optarg, NULL); break;
+			default: ir_skew_usage();
+		}
+	}
+	if (optind >= argc)
+	{
+		ir_skew_usage();
+	}
+	for (; optind < argc; optind++)
+	{
+		count += replay_load(argv[optind], &ir_skew_context.frames[count], IR_SKEW_FRAMES_MAX - count);
+	}
+
+	/* Receivers share the pin and TIM1, the second one takes them over at initialization. */
+	ir_baseline_initialize();
+	ir_baseline_set_callback(ir_skew_baseline_callback, NULL);
+	ir_skew_run(0, count, rounds, options);
+	ir_initialize();
+	ir_set_frame_callback(ir_skew_callback, NULL);
+	ir_skew_run(1, count, rounds, options);
+
+	printf("jitter %u us, drift %d permille\n", (unsigned)options.jitter_usec, (int)options.drift_permille);
+	printf("skew permille  oversampling  edges\n");
+	for (point = 0; point < IR_SKEW_POINTS; point++)
+	{
+		const int32_t skew = ir_skew_point(point);
+
+		printf("%13d  %10.1f %%  %5.1f %%\n", (int)skew, ir_skew_context.received[0][point], ir_skew_context.received[1][point]);
+		if ((skew >= -range_permille) && (skew <= range_permille) && (ir_skew_context.received[1][point] < min_received_percent))
+		{
+			failed = true;
+		}
+	}
+	if (failed)
+	{
+		printf("FAILED: received less than %.1f %% within %d permille of skew\n", min_received_percent, (int)range_permille);
+		return 1;
+	}
+	return 0;
+}
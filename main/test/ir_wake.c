@@ -0,0 +1,136 @@
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "shim.h"
+#include "ir.h"
+#include "replay.h"
+
+/*
+ * Wake path of power manager: every frame is the first one after quiet signal, MCU is stopped before it
+ * if ir_is_quiet() allows, and its first edge is served after wakeup delay, while GPT timer of ir.c doesn't count.
+ * Frames are played with and without ir_wakeup() compensation of the delay, for delays up to -D.
+ * Repeat frames are skipped, they are never the first frame of key press.
+ * Fails if a frame with compensation is lost within delay given by -w, or if MCU was not allowed to stop.
+ */
+
+#define IR_WAKE_FRAMES_MAX      512u
+#define IR_WAKE_STEP_USEC       100u
+
+static struct
+{
+	replay_frame_t        frames[IR_WAKE_FRAMES_MAX];
+	size_t                count;
+}ir_wake_context;
+
+static void ir_wake_callback(void *context, ir_protocol_t protocol, uint16_t address, uint8_t command, bool repeat)
+{
+	(void)context;
+	replay_report(protocol, address, command, repeat);
+}
+
+static void ir_wake_run(uint32_t rounds, replay_options_t options, replay_result_t *result)
+{
+	const uint32_t seed = options.seed;
+	uint32_t round;
+	size_t i;
+
+	for (round = 0; round < rounds; round++)
+	{
+		options.seed = seed + round;
+		for (i = 0; i < ir_wake_context.count; i++)
+		{
+			replay_run(&ir_wake_context.frames[i], 1, &options, result);
+		}
+	}
+}
+
+static void ir_wake_usage(void)
+{
+	fprintf(stderr,
+	        "Usage: ir_wake [options] trace...\n"
+	        "  -r rounds      plays of every frame per delay, 1 by default\n"
+	        "  -j usec        jitter of edges, both directions\n"
+	        "  -S seed        seed of random errors\n"
+	        "  -D usec        longest wakeup delay, 800 by default\n"
+	        "  -w usec        fail if a frame is lost with compensation of shorter delay, 0 by default\n");
+	exit(2);
+}
+
+int main(int argc, char *argv[])
+{
+	replay_options_t options = {.seed = 1, .stop_callback = ir_is_quiet};
+	uint32_t max_delay_usec = 800;
+	uint32_t checked_usec = 0;
+	uint32_t rounds = 1;
+	uint32_t delay;
+	bool failed = false;
+	int option;
+
+	while ((option = getopt(argc, argv, "r:j:S:D:w:")) != -1)
+	{
+		switch (option)
+		{
+			case 'r': rounds = (uint32_t)strtoul(optarg, NULL, 0); break;
+			case 'j': options.jitter_usec = (uint32_t)strtoul(optarg, NULL, 0); break;
+			case 'S': options.seed = (uint32_t)strtoul(optarg, NULL, 0); break;
+			case 'D': max_delay_usec = (uint32_t)strtoul(optarg, NULL, 0); break;
+			case 'w': checked_usec = (uint32_t)strtoul(optarg, NULL, 0); break;
+			default: ir_wake_usage();
+		}
+	}
+	if (optind >= argc)
+	{
+		ir_wake_usage();
+	}
+	for (; optind < argc; optind++)
+	{
+		replay_frame_t *frames = &ir_wake_context.frames[ir_wake_context.count];
+		const size_t count = replay_load(argv[optind], frames, IR_WAKE_FRAMES_MAX - ir_wake_context.count);
+		size_t i;
+
+		for (i = 0; i < count; i++)
+		{
+			if ((frames[i].protocol != REPLAY_PROTOCOL_NONE) && !frames[i].repeat)
+			{
+				ir_wake_context.frames[ir_wake_context.count++] = frames[i];
+			}
+		}
+	}
+
+	ir_initialize();
+	ir_set_frame_callback(ir_wake_callback, NULL);
+
+	printf("%u first frames x %u rounds, jitter %u us\n", (unsigned)ir_wake_context.count, (unsigned)rounds,
+	       (unsigned)options.jitter_usec);
+	printf("wakeup us  uncompensated  compensated\n");
+	for (delay = 0; delay <= max_delay_usec; delay += IR_WAKE_STEP_USEC)
+	{
+		replay_result_t plain = {0};
+		replay_result_t compensated = {0};
+
+		options.wakeup_usec = delay;
+		options.wakeup_callback = NULL;
+		ir_wake_run(rounds, options, &plain);
+		options.wakeup_callback = ir_wakeup;
+		ir_wake_run(rounds, options, &compensated);
+
+		printf("%9u  %11.1f %%  %9.1f %%\n", (unsigned)delay, 100.0 * plain.received / plain.frames,
+		       100.0 * compensated.received / compensated.frames);
+		if ((plain.stops != plain.frames) || (compensated.stops != compensated.frames))
+		{
+			printf("MCU was not stopped before %u frames\n",
+			       (unsigned)(plain.frames - plain.stops + compensated.frames - compensated.stops));
+			failed = true;
+		}
+		if ((delay <= checked_usec) && ((compensated.received != compensated.frames) || (compensated.false_positives != 0)))
+		{
+			failed = true;
+		}
+	}
+	if (failed)
+	{
+		printf("FAILED: MCU was not stopped or first frame was lost with wakeup up to %u us\n", (unsigned)checked_usec);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,99 @@
+#include <math.h>
+#include <stdio.h>
+#include "hal.h"
+#include "pwm.h"
+#include "config.h"
+
+/*
+ * Check of brightness table of pwm.c, which compiler generates from PWM_CURVE of config.h.
+ * Compare values must not go down with growing level, and must be the curve evaluated here by libm, rounded to 1/16 tick.
+ * Reports the largest error of compare value, the largest lightness step between neighbouring levels
+ * and levels which are equal to previous one, gamma curves are flat below 1/16 tick at the lowest levels.
+ */
+
+#define PWM_CURVE_FULL_SCALE    ((double)((uint32_t)PWM_PERIOD << PWM_FRACTION_BITS))
+#define PWM_CURVE_ERROR_MAX     0.5001  /** Rounding of table, 1/16 ticks, and float error. */
+
+/** Relative luminance of level, 0..1. */
+static double pwm_curve_luminance(uint32_t level)
+{
+	const double ratio = (double)level / PWM_LEVEL_MAX;
+#if PWM_CURVE == PWM_CURVE_CIE1931
+	const double lightness = 100.0 * ratio;
+	return (lightness > 8.0) ? pow((lightness + 16.0) / 116.0, 3.0) : lightness / 903.3;
+#elif PWM_CURVE == PWM_CURVE_QUADRATIC
+	return pow(ratio, 2.0);
+#else
+	return pow(ratio, 3.0);
+#endif
+}
+
+/** CIE 1931 lightness 0..100 of relative luminance. */
+static double pwm_curve_lightness(double luminance)
+{
+	return (luminance > 216.0 / 24389.0) ? 116.0 * cbrt(luminance) - 16.0 : 903.3 * luminance;
+}
+
+int main(void)
+{
+	static const char *const names[] = {"", "CIE 1931", "gamma 2", "gamma 3"};
+	double error_max = 0;
+	double step_max = 0;
+	uint32_t error_level = 0;
+	uint32_t step_level = 0;
+	uint32_t flat = 0;
+	uint32_t decreasing = 0;
+	uint32_t level;
+
+	for (level = 0; level <= PWM_LEVEL_MAX; level++)
+	{
+		const uint32_t ticks = pwm_level_ticks((uint16_t)level);
+		const double error = fabs((double)ticks - pwm_curve_luminance(level) * PWM_CURVE_FULL_SCALE);
+
+		if (error > error_max)
+		{
+			error_max = error;
+			error_level = level;
+		}
+		if (level == 0)
+		{
+			continue;
+		}
+		const uint32_t previous = pwm_level_ticks((uint16_t)(level - 1u));
+		if (ticks < previous)
+		{
+			if (decreasing < 10u)
+			{
+				printf("level %u: %u is below %u of level %u\n", (unsigned)level, (unsigned)ticks, (unsigned)previous,
+				       (unsigned)(level - 1u));
+			}
+			decreasing++;
+		}
+		else if (ticks == previous)
+		{
+			flat++;
+		}
+		const double step = pwm_curve_lightness(ticks / PWM_CURVE_FULL_SCALE) - pwm_curve_lightness(previous / PWM_CURVE_FULL_SCALE);
+		if (step > step_max)
+		{
+			step_max = step;
+			step_level = level;
+		}
+	}
+
+	printf("%s curve, %u levels, full scale %u/16 ticks\n", names[PWM_CURVE], (unsigned)(PWM_LEVEL_MAX + 1u),
+	       (unsigned)PWM_CURVE_FULL_SCALE);
+	printf("largest error %.3f/16 tick at level %u, largest lightness step %.3f at level %u, %u levels equal to previous\n",
+	       error_max, (unsigned)error_level, step_max, (unsigned)step_level, (unsigned)flat);
+	if ((pwm_level_ticks(0) != 0) || (pwm_level_ticks(PWM_LEVEL_MAX) != PWM_CURVE_FULL_SCALE))
+	{
+		printf("FAILED: table does not span 0..full scale\n");
+		return 1;
+	}
+	if ((decreasing != 0) || (error_max > PWM_CURVE_ERROR_MAX))
+	{
+		printf("FAILED: table is not monotonic or error is above %.4f/16 tick\n", PWM_CURVE_ERROR_MAX);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,104 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "hal.h"
+#include "pwm.h"
+#include "config.h"
+
+/*
+ * Simulation of sigma-delta dithering of pwm.c: compare values of PWM periods made by pwm_quantize()
+ * for every brightness level, as fade engine makes them for steady level.
+ * Average duty of all periods must be the requested one, except the lowest levels which are raised
+ * to keep pulses frequent, and pulses must come at least PWM_DITHER_RATE_MIN times per second.
+ * Prints average duty against requested one of the lowest levels.
+ */
+
+#define PWM_DITHER_SECONDS      4u
+#define PWM_DITHER_PERIODS      (PWM_DITHER_SECONDS * PWM_FREQUENCY / PWM_PERIOD)
+#define PWM_DITHER_RATE_MIN     200u    /** Pulses per second, slower ones flicker. */
+#define PWM_DITHER_PRINTED      24u     /** Lowest levels printed. */
+
+typedef struct
+{
+	double                average;        /** Average compare value, 1/16 ticks. */
+	uint32_t              gap_max;        /** Longest run of periods without pulse. */
+}pwm_dither_result_t;
+
+static pwm_dither_result_t pwm_dither_run(uint32_t target)
+{
+	pwm_dither_result_t result = {0};
+	uint64_t sum = 0;
+	int32_t error = 0;
+	uint32_t gap = 0;
+	uint32_t period;
+
+	for (period = 0; period < PWM_DITHER_PERIODS; period++)
+	{
+		const uint16_t ticks = pwm_quantize(&error, target);
+
+		sum += (uint64_t)ticks << PWM_FRACTION_BITS;
+		gap = (ticks == 0) ? gap + 1u : 0;
+		if (gap > result.gap_max)
+		{
+			result.gap_max = gap;
+		}
+	}
+	result.average = (double)sum / PWM_DITHER_PERIODS;
+	return result;
+}
+
+int main(void)
+{
+	const double periods_per_sec = (double)PWM_FREQUENCY / PWM_PERIOD;
+	const double pulse_max = (double)(PWM_FREQUENCY / 400000u) * (1u << PWM_FRACTION_BITS); /** Error limit of sigma-delta. */
+	double raised_max = 0;
+	double error_max = 0;
+	double rate_min = periods_per_sec;
+	uint32_t raised = 0;
+	uint32_t distinct = 0;
+	double previous = -1.0;
+	uint32_t level;
+
+	printf("%u Hz PWM, %u periods per level\n", (unsigned)(PWM_FREQUENCY / PWM_PERIOD), (unsigned)PWM_DITHER_PERIODS);
+	printf("level  requested  average  ticks, lowest pulse rate Hz\n");
+	for (level = 1; level <= PWM_LEVEL_MAX; level++)
+	{
+		const uint32_t target = pwm_level_ticks((uint16_t)level);
+		const pwm_dither_result_t result = pwm_dither_run(target);
+		const double error = result.average - target;
+		const double rate = periods_per_sec / (result.gap_max + 1u);
+
+		if (level <= PWM_DITHER_PRINTED)
+		{
+			printf("%5u  %9.4f  %7.4f  %.0f\n", (unsigned)level, target / 16.0, result.average / 16.0, rate);
+		}
+		if (error > pulse_max / PWM_DITHER_PERIODS)
+		{
+			/* Raised to keep pulse rate, it is the same for all the lowest levels. */
+			raised++;
+			raised_max = (target > raised_max) ? target : raised_max;
+		}
+		else if (fabs(error) > error_max)
+		{
+			error_max = fabs(error);
+		}
+		if (rate < rate_min)
+		{
+			rate_min = rate;
+		}
+		if (result.average > previous + 0.5)
+		{
+			distinct++;
+			previous = result.average;
+		}
+	}
+
+	printf("%u lowest levels up to %.4f ticks are raised, error of others %.5f ticks, lowest pulse rate %.0f Hz, %u distinct averages\n",
+	       (unsigned)raised, raised_max / 16.0, error_max / 16.0, rate_min, (unsigned)distinct);
+	if ((error_max > pulse_max / PWM_DITHER_PERIODS) || (rate_min < PWM_DITHER_RATE_MIN))
+	{
+		printf("FAILED: average duty differs from requested one or pulse rate is below %u Hz\n", (unsigned)PWM_DITHER_RATE_MIN);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,265 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "shim.h"
+#include "pwm.h"
+#include "fade.h"
+#include "config.h"
+
+/*
+ * Simulation of phase staggering of pwm.c with fade engine of fade.c, all PWM channels and tunable white.
+ * Channels 0 and 1 get compare values by DMA, the others are set by pwm_ticks_set() and pwm_set_channels().
+ * Outputs are evaluated from active compare values and modes of timer registers at every counter value of period.
+ * Reports peak number of channels which are on at the same time, with staggering and if all were front aligned.
+ * Fails if duty of any channel is not the set one, if channels set together don't change at the same update
+ * or a channel set by pwm_ticks_set() doesn't change at the next one,
+ * or if staggering doesn't lower the peak.
+ */
+
+#define PWM_STAGGER_TRIALS      500u
+#define PWM_STAGGER_FLUSH       512u    /** Updates until DMA buffer has new level, twice its size at least. */
+#define PWM_STAGGER_SETS        200u    /** Random sets of channels by pwm_set_channels(). */
+#define PWM_STAGGER_SET_MASK    (((1u << PWM_CHANNELS) - 1u) & ~((1u << PWM_DMA_CHANNELS) - 1u))
+
+static struct
+{
+	uint32_t              random;         /** State of xorshift generator. */
+	uint32_t              on_ticks[PWM_CHANNELS];
+	uint32_t              errors;
+}pwm_stagger_context = {.random = 1};
+
+static uint32_t pwm_stagger_random(uint32_t range)
+{
+	uint32_t x = pwm_stagger_context.random;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	pwm_stagger_context.random = x;
+	return x % range;
+}
+
+static PWMDriver *pwm_stagger_driver(uint32_t channel)
+{
+	return (channel < 4u) ? &PWMD3 : &PWMD4;
+}
+
+static void pwm_stagger_flush(void)
+{
+	uint32_t i;
+
+	for (i = 0; i < PWM_STAGGER_FLUSH; i++)
+	{
+		shim_pwm_update(&PWMD3);
+	}
+}
+
+/** Peak number of channels on at the same time in current period, on ticks of channels are counted too. */
+static uint32_t pwm_stagger_peak(void)
+{
+	uint32_t peak = 0;
+	uint32_t counter;
+	uint32_t channel;
+
+	for (channel = 0; channel < PWM_CHANNELS; channel++)
+	{
+		pwm_stagger_context.on_ticks[channel] = 0;
+	}
+	for (counter = 0; counter < PWM_PERIOD; counter++)
+	{
+		uint32_t on = 0;
+		for (channel = 0; channel < PWM_CHANNELS; channel++)
+		{
+			if (shim_pwm_output(pwm_stagger_driver(channel), channel % 4u, counter))
+			{
+				pwm_stagger_context.on_ticks[channel]++;
+				on++;
+			}
+		}
+		peak = (on > peak) ? on : peak;
+	}
+	return peak;
+}
+
+static void pwm_stagger_error(const char *reason, uint32_t channel, uint32_t value, uint32_t expected)
+{
+	if (pwm_stagger_context.errors < 10u)
+	{
+		printf("%s: channel %u is %u, expected %u\n", reason, (unsigned)channel, (unsigned)value, (unsigned)expected);
+	}
+	pwm_stagger_context.errors++;
+}
+
+/* Back aligned DMA channel with the same gain as front aligned one must have the same duty, and be off at zero. */
+static void pwm_stagger_check_dma(void)
+{
+	const uint32_t gains[PWM_DMA_CHANNELS] = {[0 ... PWM_DMA_CHANNELS - 1] = FADE_GAIN_ONE / 3u};
+	uint32_t channel;
+	uint32_t i;
+
+	fade_set_gains(gains);
+	for (channel = PWM_DMA_CHANNELS; channel < PWM_CHANNELS; channel++)
+	{
+		pwm_ticks_set(channel, 0);
+	}
+	fade_to(0, 0, FADE_LINEAR);
+	pwm_stagger_flush();
+	(void)pwm_stagger_peak();
+	for (channel = 0; channel < PWM_CHANNELS; channel++)
+	{
+		if (pwm_stagger_context.on_ticks[channel] != 0)
+		{
+			pwm_stagger_error("level 0", channel, pwm_stagger_context.on_ticks[channel], 0);
+		}
+	}
+	if (!pwm_is_off())
+	{
+		pwm_stagger_error("pwm_is_off() at level 0", 0, 0, 1);
+	}
+
+	fade_to(PWM_LEVEL_MAX / 2u, 0, FADE_LINEAR);
+	pwm_stagger_flush();
+	for (i = 0; i < 16u; i++)
+	{
+		shim_pwm_update(&PWMD3);
+		(void)pwm_stagger_peak();
+		for (channel = 1; channel < PWM_DMA_CHANNELS; channel++)
+		{
+			if (pwm_stagger_context.on_ticks[channel] != pwm_stagger_context.on_ticks[0])
+			{
+				pwm_stagger_error("DMA duty", channel, pwm_stagger_context.on_ticks[channel], pwm_stagger_context.on_ticks[0]);
+			}
+		}
+	}
+	if (pwm_is_off())
+	{
+		pwm_stagger_error("pwm_is_off() at half level", 0, 1, 0);
+	}
+}
+
+/*
+ * Channels in mask keep their duties till the next update and all of them have new ones after it,
+ * also when alignment is changed by interrupt of that update.
+ */
+static void pwm_stagger_check_sets(void)
+{
+	uint32_t deferred = 0;
+	uint32_t set;
+
+	for (set = 0; set < PWM_STAGGER_SETS; set++)
+	{
+		uint32_t before[PWM_CHANNELS];
+		uint16_t values[PWM_CHANNELS] = {0};
+		uint32_t mask = 0;
+		uint32_t channel;
+
+		(void)pwm_stagger_peak();
+		for (channel = PWM_DMA_CHANNELS; channel < PWM_CHANNELS; channel++)
+		{
+			before[channel] = pwm_stagger_context.on_ticks[channel];
+			if (pwm_stagger_random(2u) != 0)
+			{
+				values[channel] = (uint16_t)pwm_stagger_random(PWM_PERIOD + 1u);
+				mask |= 1u << channel;
+			}
+		}
+		pwm_set_channels(values, mask);
+		deferred += (PWMD3.tim->DIER & STM32_TIM_DIER_UIE) ? 1u : 0u;
+
+		(void)pwm_stagger_peak();
+		for (channel = PWM_DMA_CHANNELS; channel < PWM_CHANNELS; channel++)
+		{
+			if (pwm_stagger_context.on_ticks[channel] != before[channel])
+			{
+				pwm_stagger_error("set before update", channel, pwm_stagger_context.on_ticks[channel], before[channel]);
+			}
+		}
+		shim_pwm_update(&PWMD3);
+		(void)pwm_stagger_peak();
+		for (channel = PWM_DMA_CHANNELS; channel < PWM_CHANNELS; channel++)
+		{
+			const uint32_t expected = (mask & (1u << channel)) ? values[channel] : before[channel];
+			if (pwm_stagger_context.on_ticks[channel] != expected)
+			{
+				pwm_stagger_error("set after update", channel, pwm_stagger_context.on_ticks[channel], expected);
+			}
+		}
+	}
+	printf("%u channel sets by pwm_set_channels(), %u with alignment changed by interrupt\n",
+	       (unsigned)PWM_STAGGER_SETS, (unsigned)deferred);
+}
+
+int main(void)
+{
+	uint32_t aligned_sum = 0;
+	uint32_t staggered_sum = 0;
+	uint32_t aligned_max = 0;
+	uint32_t staggered_max = 0;
+	uint32_t trial;
+
+	pwm_initialize();
+	fade_initialize();
+	pwm_stagger_check_dma();
+	pwm_stagger_check_sets();
+
+	for (trial = 0; trial < PWM_STAGGER_TRIALS; trial++)
+	{
+		/* Lamps are dimmed often, so a quarter of trials has duties up to quarter of period, and so on. */
+		const uint32_t duty_max = (trial % 4u + 1u) * PWM_PERIOD / 4u;
+		uint16_t duties[PWM_CHANNELS];
+		uint32_t gains[PWM_DMA_CHANNELS];
+		uint32_t aligned = 0;
+		uint32_t staggered;
+		uint32_t channel;
+
+		for (channel = 0; channel < PWM_DMA_CHANNELS; channel++)
+		{
+			gains[channel] = pwm_stagger_random(FADE_GAIN_ONE + 1u);
+		}
+		fade_set_gains(gains);
+		fade_to((uint16_t)pwm_stagger_random(PWM_LEVEL_MAX + 1u), 0, FADE_LINEAR);
+		for (channel = PWM_DMA_CHANNELS; channel < PWM_CHANNELS; channel++)
+		{
+			duties[channel] = (uint16_t)pwm_stagger_random(duty_max);
+		}
+		/* Alignment is recomputed by pwm_set_channels(), pwm_ticks_set() keeps it. */
+		pwm_set_channels(duties, PWM_STAGGER_SET_MASK);
+		pwm_stagger_flush();
+
+		staggered = pwm_stagger_peak();
+		for (channel = 0; channel < PWM_CHANNELS; channel++)
+		{
+			aligned += (pwm_stagger_context.on_ticks[channel] != 0) ? 1u : 0u;
+			if ((channel >= PWM_DMA_CHANNELS) && (pwm_stagger_context.on_ticks[channel] != duties[channel]))
+			{
+				pwm_stagger_error("duty", channel, pwm_stagger_context.on_ticks[channel], duties[channel]);
+			}
+		}
+		aligned_sum += aligned;
+		staggered_sum += staggered;
+		aligned_max = (aligned > aligned_max) ? aligned : aligned_max;
+		staggered_max = (staggered > staggered_max) ? staggered : staggered_max;
+
+		/* Single channel changes at the next update in alignment it has. */
+		channel = PWM_DMA_CHANNELS + pwm_stagger_random(PWM_CHANNELS - PWM_DMA_CHANNELS);
+		duties[channel] = (uint16_t)pwm_stagger_random(PWM_PERIOD + 1u);
+		pwm_ticks_set(channel, duties[channel]);
+		shim_pwm_update(&PWMD3);
+		(void)pwm_stagger_peak();
+		if (pwm_stagger_context.on_ticks[channel] != duties[channel])
+		{
+			pwm_stagger_error("pwm_ticks_set() duty", channel, pwm_stagger_context.on_ticks[channel], duties[channel]);
+		}
+	}
+
+	printf("%u channels, %u DMA channels, %u random duty sets\n", (unsigned)PWM_CHANNELS, (unsigned)PWM_DMA_CHANNELS,
+	       (unsigned)PWM_STAGGER_TRIALS);
+	printf("peak channels on at once: front aligned %.2f (max %u), staggered %.2f (max %u)\n",
+	       (double)aligned_sum / PWM_STAGGER_TRIALS, (unsigned)aligned_max,
+	       (double)staggered_sum / PWM_STAGGER_TRIALS, (unsigned)staggered_max);
+	if ((pwm_stagger_context.errors != 0) || (staggered_sum >= aligned_sum))
+	{
+		printf("FAILED: %u wrong duties, or staggering doesn't lower the peak\n", (unsigned)pwm_stagger_context.errors);
+		return 1;
+	}
+	return 0;
+}
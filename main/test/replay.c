@@ -0,0 +1,316 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hal.h"
+#include "shim.h"
+#include "replay.h"
+#include "config.h"
+
+#define REPLAY_QUIET_USEC       200000u /** Quiet signal before frames, longer than any gap between repeats. */
+#define REPLAY_REPORTS_MAX      8u      /** Reports kept per frame. */
+#define REPLAY_EDGES_MAX        (REPLAY_DURATIONS_MAX + 2u)
+#define REPLAY_LINE_SIZE        2048u
+
+#if IR_PIN_INVERTED == TRUE
+#define REPLAY_MARK_LEVEL       PAL_LOW
+#define REPLAY_SPACE_LEVEL      PAL_HIGH
+#else
+#define REPLAY_MARK_LEVEL       PAL_HIGH
+#define REPLAY_SPACE_LEVEL      PAL_LOW
+#endif
+
+typedef struct
+{
+	uint64_t              time;           /** Time since frame start, nanoseconds. */
+	bool                  mark;           /** Level after the edge. */
+}replay_edge_t;
+
+static const char *const replay_protocol_names[] = {"NEC", "RC5", "RC6", "SIRC", "SAMSUNG32", "none"};
+
+static struct
+{
+	uint32_t              random;         /** State of xorshift generator. */
+	ir_frame_t            reports[REPLAY_REPORTS_MAX];
+	uint32_t              report_count;
+}replay_context;
+
+
+int replay_protocol_parse(const char *name)
+{
+	int protocol;
+
+	for (protocol = 0; protocol <= (int)REPLAY_PROTOCOL_NONE; protocol++)
+	{
+		if (strcmp(name, replay_protocol_names[protocol]) == 0)
+		{
+			return protocol;
+		}
+	}
+	return -1;
+}
+
+const char *replay_protocol_name(ir_protocol_t protocol)
+{
+	return (protocol <= REPLAY_PROTOCOL_NONE) ? replay_protocol_names[protocol] : "?";
+}
+
+static void replay_error(const char *path, unsigned line, const char *reason)
+{
+	fprintf(stderr, "%s:%u: %s\n", path, line, reason);
+	exit(2);
+}
+
+size_t replay_load(const char *path, replay_frame_t *frames, size_t size)
+{
+	char text[REPLAY_LINE_SIZE];
+	replay_frame_t *frame = NULL;
+	unsigned line = 0;
+	size_t count = 0;
+	FILE *file = fopen(path, "r");
+
+	if (file == NULL)
+	{
+		replay_error(path, 0, "cannot open");
+	}
+	while (fgets(text, sizeof(text), file) != NULL)
+	{
+		char *token;
+		line++;
+		if ((text[0] == '#') || (strtok(text, " \t\r\n") == NULL))
+		{
+			continue;
+		}
+		token = text;
+		if (strcmp(token, "frame") == 0)
+		{
+			const char *protocol = strtok(NULL, " \t\r\n");
+			const char *address = strtok(NULL, " \t\r\n");
+			const char *command = strtok(NULL, " \t\r\n");
+			const char *repeat = strtok(NULL, " \t\r\n");
+			int value;
+
+			if ((protocol == NULL) || (address == NULL) || (command == NULL) || (repeat == NULL))
+			{
+				replay_error(path, line, "frame needs protocol, address, command and repeat");
+			}
+			value = replay_protocol_parse(protocol);
+			if (value < 0)
+			{
+				replay_error(path, line, "unknown protocol");
+			}
+			if (count >= size)
+			{
+				replay_error(path, line, "too many frames");
+			}
+			frame = &frames[count++];
+			frame->protocol = (ir_protocol_t)value;
+			frame->address = (uint16_t)strtoul(address, NULL, 0);
+			frame->command = (uint8_t)strtoul(command, NULL, 0);
+			frame->repeat = strtoul(repeat, NULL, 0) != 0;
+			frame->count = 0;
+			continue;
+		}
+		if (frame == NULL)
+		{
+			replay_error(path, line, "durations before frame");
+		}
+		for (; token != NULL; token = strtok(NULL, " \t\r\n"))
+		{
+			char *end;
+			const unsigned long duration = strtoul(token, &end, 10);
+			if ((*end != '\0') || (duration == 0) || !isdigit((unsigned char)token[0]))
+			{
+				replay_error(path, line, "wrong duration");
+			}
+			if (frame->count >= REPLAY_DURATIONS_MAX)
+			{
+				replay_error(path, line, "too many durations");
+			}
+			frame->durations[frame->count++] = (uint32_t)duration;
+		}
+	}
+	fclose(file);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		if ((frames[i].count < 2) || (frames[i].count % 2 != 0))
+		{
+			replay_error(path, line, "frame must end with space");
+		}
+	}
+	return count;
+}
+
+static uint32_t replay_random(void)
+{
+	uint32_t x = replay_context.random;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	replay_context.random = x;
+	return x;
+}
+
+/** Random value -range..range. */
+static int64_t replay_random_range(uint32_t range)
+{
+	return (int64_t)(replay_random() % (2u * range + 1u)) - (int64_t)range;
+}
+
+/** Edges of frame with injected errors, the last one is the end of gap. */
+static uint32_t replay_edges(const replay_frame_t *frame, const replay_options_t *options, replay_edge_t *edges)
+{
+	uint64_t nominal = 0;
+	uint32_t count = 0;
+	uint32_t glitch_level = REPLAY_DURATIONS_MAX;
+	uint32_t i;
+
+	if ((options->glitch_permille != 0) && ((replay_random() % 1000u) < options->glitch_permille))
+	{
+		glitch_level = replay_random() % (frame->count - 1u);
+	}
+
+	for (i = 0; i < frame->count; i++)
+	{
+		const int32_t skew = options->skew_permille + options->drift_permille * (int32_t)i / (int32_t)(frame->count - 1u);
+		const uint64_t duration = (uint64_t)frame->durations[i] * SHIM_NSEC_PER_USEC * (uint64_t)(1000 + skew) / 1000u;
+		int64_t time = (int64_t)nominal;
+
+		if ((i != 0) && (options->jitter_usec != 0))
+		{
+			time += replay_random_range(options->jitter_usec) * SHIM_NSEC_PER_USEC;
+		}
+		/* Edges keep their order, as receiver output does. */
+		if ((count != 0) && (time <= (int64_t)edges[count - 1].time))
+		{
+			time = (int64_t)edges[count - 1].time + SHIM_NSEC_PER_USEC;
+		}
+		edges[count].time = (uint64_t)time;
+		edges[count].mark = (i % 2u) == 0;
+		count++;
+
+		if ((i == glitch_level) && (duration > 3u * options->glitch_usec * SHIM_NSEC_PER_USEC))
+		{
+			const uint64_t glitch = (uint64_t)options->glitch_usec * SHIM_NSEC_PER_USEC;
+			const uint64_t offset = glitch + replay_random() % (duration - 2u * glitch);
+			edges[count].time = edges[count - 1].time + offset;
+			edges[count].mark = (i % 2u) != 0;
+			edges[count + 1].time = edges[count].time + glitch;
+			edges[count + 1].mark = (i % 2u) == 0;
+			count += 2;
+		}
+		nominal += duration;
+	}
+	edges[count].time = (nominal > edges[count - 1].time) ? nominal : edges[count - 1].time + SHIM_NSEC_PER_USEC;
+	edges[count].mark = false;
+	return count + 1;
+}
+
+static bool replay_same_key(const ir_frame_t *report, const replay_frame_t *frame)
+{
+	return (report->protocol == frame->protocol) && (report->address == frame->address) &&
+	       (report->command == frame->command);
+}
+
+static void replay_check(const replay_frame_t *frame, replay_result_t *result)
+{
+	bool received = false;
+	uint32_t i;
+
+	if (frame->protocol == REPLAY_PROTOCOL_NONE)
+	{
+		result->noise++;
+	}
+	else
+	{
+		result->frames++;
+	}
+	for (i = 0; i < replay_context.report_count; i++)
+	{
+		if (!received && replay_same_key(&replay_context.reports[i], frame))
+		{
+			/* Repeat is a new press for receiver which lost the previous frame, it is not a false key. */
+			received = true;
+			if (replay_context.reports[i].repeat == frame->repeat)
+			{
+				result->received++;
+			}
+			else
+			{
+				result->repeat_errors++;
+			}
+		}
+		else
+		{
+			result->false_positives++;
+		}
+	}
+}
+
+/** MCU is stopped till the first edge, its interrupt is served after clocks are restarted. */
+static void replay_stop(uint64_t edge_time, const replay_options_t *options)
+{
+	shim_stop();
+	shim_advance(edge_time - shim_now() + (uint64_t)options->wakeup_usec * SHIM_NSEC_PER_USEC);
+	shim_wake();
+	if (options->wakeup_callback != NULL)
+	{
+		options->wakeup_callback(options->wakeup_usec);
+	}
+}
+
+void replay_run(const replay_frame_t *frames, size_t count, const replay_options_t *options, replay_result_t *result)
+{
+	static replay_edge_t edges[REPLAY_EDGES_MAX];
+	size_t i;
+
+	replay_context.random = (options->seed != 0) ? options->seed : 1u;
+	shim_set_pad(IR_PORT, IR_PIN, REPLAY_SPACE_LEVEL);
+	shim_advance((uint64_t)REPLAY_QUIET_USEC * SHIM_NSEC_PER_USEC);
+
+	for (i = 0; i < count; i++)
+	{
+		const uint64_t start = shim_now();
+		const uint32_t edge_count = replay_edges(&frames[i], options, edges);
+		uint32_t j;
+
+		replay_context.report_count = 0;
+		if ((i == 0) && (options->stop_callback != NULL) && options->stop_callback())
+		{
+			replay_stop(start + edges[0].time, options);
+			result->stops++;
+		}
+		for (j = 0; j < edge_count; j++)
+		{
+			/* Edges during wakeup are served late. */
+			if (start + edges[j].time > shim_now())
+			{
+				shim_advance(start + edges[j].time - shim_now());
+			}
+			if (j + 1u < edge_count)
+			{
+				shim_set_pad(IR_PORT, IR_PIN, edges[j].mark ? REPLAY_MARK_LEVEL : REPLAY_SPACE_LEVEL);
+				result->edges++;
+			}
+		}
+		replay_check(&frames[i], result);
+		if (options->frame_callback != NULL)
+		{
+			options->frame_callback(i, replay_context.reports, replay_context.report_count);
+		}
+	}
+}
+
+void replay_report(ir_protocol_t protocol, uint16_t address, uint8_t command, bool repeat)
+{
+	if (replay_context.report_count < REPLAY_REPORTS_MAX)
+	{
+		ir_frame_t *report = &replay_context.reports[replay_context.report_count++];
+		report->protocol = protocol;
+		report->address = address;
+		report->command = command;
+		report->repeat = repeat;
+	}
+}
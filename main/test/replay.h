@@ -0,0 +1,73 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "ir.h"
+#include "ir_protocol.h"
+
+/*
+ * Replay of infrared traces through the pin of receiver.
+ * Trace file has a frame header line and duration lines per frame:
+ *   frame <protocol|none> <address> <command> <repeat>
+ *   <mark usec> <space usec> <mark usec> ... <space usec>
+ * Durations alternate from mark, the last space is the gap to the next frame.
+ * Protocol "none" is noise, nothing may be received from it.
+ * Lines beginning with '#' are comments.
+ */
+
+#define REPLAY_DURATIONS_MAX    160u    /** Marks and spaces of one frame. */
+#define REPLAY_PROTOCOL_NONE    IR_PROTOCOL_COUNT
+
+typedef struct
+{
+	ir_protocol_t         protocol;                           /** Expected protocol or REPLAY_PROTOCOL_NONE. */
+	uint16_t              address;                            /** Expected address. */
+	uint8_t               command;                            /** Expected command. */
+	bool                  repeat;                             /** Expected repeat flag. */
+	uint32_t              durations[REPLAY_DURATIONS_MAX];    /** Marks and spaces, microseconds. */
+	uint32_t              count;                              /** Number of durations. */
+}replay_frame_t;
+
+/** Called after every played frame with frames received meanwhile. */
+typedef void (replay_frame_callback_t)(size_t index, const ir_frame_t *received, uint32_t count);
+/** Called at quiet signal before the first frame, returns true if MCU may be stopped. */
+typedef bool (replay_stop_callback_t)(void);
+/** Called after wakeup from STOP, before the interrupt of edge which woke MCU. */
+typedef void (replay_wakeup_callback_t)(uint32_t delay_usec);
+
+typedef struct
+{
+	uint32_t              jitter_usec;        /** Every edge is moved by random time up to this, both directions. */
+	uint32_t              glitch_permille;    /** Probability of one glitch per frame. */
+	uint32_t              glitch_usec;        /** Glitch is opposite level of this duration inside random mark or space. */
+	int32_t               skew_permille;      /** Clock error of remote, durations are longer by positive one. */
+	int32_t               drift_permille;     /** Change of clock error from first to last duration of frame. */
+	uint32_t              seed;               /** Seed of random injections. */
+	replay_frame_callback_t *frame_callback;  /** Optional. */
+	replay_stop_callback_t *stop_callback;    /** Optional, MCU is stopped before the first frame if it returns true. */
+	replay_wakeup_callback_t *wakeup_callback; /** Optional. */
+	uint32_t              wakeup_usec;        /** Delay of edge interrupt by wakeup, timers are stopped meanwhile too. */
+}replay_options_t;
+
+typedef struct
+{
+	uint32_t              frames;             /** Played frames which should be received. */
+	uint32_t              received;           /** Frames received exactly as expected. */
+	uint32_t              repeat_errors;      /** Frames received with wrong repeat flag, after the previous one was lost. */
+	uint32_t              noise;              /** Played frames which should not be received. */
+	uint32_t              false_positives;    /** Received frames which were not sent. */
+	uint32_t              edges;              /** Played signal changes. */
+	uint32_t              stops;              /** Times MCU was stopped before the first frame. */
+}replay_result_t;
+
+/** Appends frames of trace file, returns number of appended frames. Exits on error. */
+size_t replay_load(const char *path, replay_frame_t *frames, size_t size);
+/** Plays frames with quiet signal before them, results are added to result. */
+void replay_run(const replay_frame_t *frames, size_t count, const replay_options_t *options, replay_result_t *result);
+/** Called by receiver callback of test with received frame. */
+void replay_report(ir_protocol_t protocol, uint16_t address, uint8_t command, bool repeat);
+int replay_protocol_parse(const char *name); /** Returns protocol, REPLAY_PROTOCOL_NONE for "none" or -1 if unknown. */
+const char *replay_protocol_name(ir_protocol_t protocol);
+
+#endif //REPLAY_H
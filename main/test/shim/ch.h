@@ -0,0 +1,123 @@
+#ifndef SHIM_CH_H
+#define SHIM_CH_H
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Host shim of ChibiOS/RT kernel, only the part used by firmware modules built by test Makefile.
+ * Threads are cooperative: thread runs when it is created or its semaphore is signaled, until it waits again.
+ * Waiting thread is unwound by longjmp and restarted from its beginning when signaled,
+ * so thread functions must keep no state in local variables across waits, like ir.c decoder thread.
+ * Nothing else blocks: receiving from empty FIFO returns timeout at once.
+ * Virtual timers are called by shim_advance() like timer interrupts, up to SHIM_VIRTUAL_TIMERS_MAX of them.
+ */
+
+#ifndef TRUE
+#define TRUE                    1
+#endif
+#ifndef FALSE
+#define FALSE                   0
+#endif
+
+#define CH_CFG_ST_FREQUENCY     16000
+#define CH_CFG_ST_RESOLUTION    16
+
+#define NORMALPRIO              128
+#define LOWPRIO                 1
+#define HIGHPRIO                255
+
+#define MSG_OK                  ((msg_t)0)
+#define MSG_TIMEOUT             ((msg_t)-1)
+#define MSG_RESET               ((msg_t)-2)
+
+#define TIME_IMMEDIATE          ((sysinterval_t)0)
+#define TIME_INFINITE           ((sysinterval_t)-1)
+#define TIME_MS2I(msec)         ((sysinterval_t)(((uint64_t)(msec) * CH_CFG_ST_FREQUENCY + 999u) / 1000u))
+#define TIME_I2MS(interval)     ((uint32_t)(((uint64_t)(interval) * 1000u + CH_CFG_ST_FREQUENCY - 1u) / CH_CFG_ST_FREQUENCY))
+
+#define EVENT_MASK(eid)         ((eventmask_t)1 << (eventmask_t)(eid))
+#define ALL_EVENTS              ((eventmask_t)-1)
+
+#define THD_WORKING_AREA(s, n)  uint8_t s[n]
+#define THD_FUNCTION(tname, arg) void tname(void *arg)
+
+#define chDbgAssert(c, r)       do { if (!(c)) { shim_panic(r); } } while (false)
+
+typedef int32_t   msg_t;
+typedef uint32_t  tprio_t;
+typedef uint16_t  systime_t;
+typedef uint32_t  sysinterval_t;
+typedef uint64_t  systimestamp_t;
+typedef uint32_t  rtcnt_t;
+typedef uint32_t  eventmask_t;
+typedef uint32_t  eventflags_t;
+typedef void (*tfunc_t)(void *p);
+
+typedef struct shim_thread thread_t;
+typedef struct virtual_timer virtual_timer_t;
+typedef void (*vtfunc_t)(virtual_timer_t *vtp, void *p);
+
+struct virtual_timer
+{
+	bool                  armed;          /** Callback is pending. */
+	uint64_t              due;            /** Simulated time of callback, nanoseconds. */
+	vtfunc_t              func;
+	void                  *par;
+};
+
+typedef struct
+{
+	bool                  signaled;       /** Taken by next wait. */
+}binary_semaphore_t;
+
+typedef struct
+{
+	eventflags_t          flags;          /** Flags of all broadcasts, nobody listens. */
+}event_source_t;
+
+typedef struct
+{
+	size_t                object_size;    /** Size of one object. */
+	size_t                objects;        /** Number of objects, 32 at most. */
+	uint8_t               *buffer;        /** Storage of objects. */
+	msg_t                 *messages;      /** Mailbox of sent objects. */
+	uint32_t              free;           /** Bit per free object. */
+	uint32_t              head;           /** Number of sent objects. */
+	uint32_t              tail;           /** Number of received objects. */
+}objects_fifo_t;
+
+void shim_panic(const char *reason);
+
+void chSysLock(void);
+void chSysUnlock(void);
+void chSysLockFromISR(void);
+void chSysUnlockFromISR(void);
+rtcnt_t chSysGetRealtimeCounterX(void);
+
+thread_t *chThdCreateStatic(void *wsp, size_t size, tprio_t prio, tfunc_t pf, void *arg);
+void chRegSetThreadName(const char *name);
+
+void chBSemObjectInit(binary_semaphore_t *bsp, bool taken);
+msg_t chBSemWait(binary_semaphore_t *bsp);
+void chBSemSignal(binary_semaphore_t *bsp);
+void chBSemSignalI(binary_semaphore_t *bsp);
+
+void chFifoObjectInit(objects_fifo_t *ofp, size_t objsize, size_t objn, void *objbuf, msg_t *msgbuf);
+void *chFifoTakeObjectTimeout(objects_fifo_t *ofp, sysinterval_t timeout);
+void chFifoSendObject(objects_fifo_t *ofp, void *objp);
+msg_t chFifoReceiveObjectTimeout(objects_fifo_t *ofp, void **objpp, sysinterval_t timeout);
+void chFifoReturnObject(objects_fifo_t *ofp, void *objp);
+
+void chEvtObjectInit(event_source_t *esp);
+void chEvtBroadcastFlagsI(event_source_t *esp, eventflags_t flags);
+
+systime_t chVTGetSystemTimeX(void);
+systimestamp_t chVTGetTimeStamp(void);
+systimestamp_t chVTGetTimeStampI(void);
+void chVTObjectInit(virtual_timer_t *vtp);
+void chVTSetI(virtual_timer_t *vtp, sysinterval_t delay, vtfunc_t vtfunc, void *par);
+void chVTResetI(virtual_timer_t *vtp);
+bool chVTIsArmedI(const virtual_timer_t *vtp);
+
+#endif //SHIM_CH_H
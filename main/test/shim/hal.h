@@ -0,0 +1,217 @@
+#ifndef SHIM_HAL_H
+#define SHIM_HAL_H
+#include <stdint.h>
+#include <stdbool.h>
+#include "ch.h"
+
+/*
+ * Host shim of ChibiOS HAL: GPT and PWM timers, DMA streams and PAL pads of STM32F1.
+ * Time is simulated, see shim.h, GPT timers count it and pad levels are set by test.
+ * PWM timers are registers, update events are made by test, see shim_pwm_update().
+ */
+
+#define STM32_GPT_USE_TIM1      TRUE
+#define STM32_GPT_USE_TIM2      TRUE
+
+#define STM32_TIM_CR1_UDIS      (1u << 1)
+#define STM32_TIM_CR2_MMS(n)    ((uint32_t)(n) << 4)
+#define STM32_TIM_SMCR_SMS(n)   ((uint32_t)(n) << 0)
+#define STM32_TIM_SMCR_TS(n)    ((uint32_t)(n) << 4)
+#define STM32_TIM_DIER_UIE      (1u << 0)
+#define STM32_TIM_DIER_UDE      (1u << 8)
+#define STM32_TIM_DCR_DBA(n)    ((uint32_t)(n) << 0)
+#define STM32_TIM_DCR_DBL(n)    ((uint32_t)(n) << 8)
+#define STM32_TIM_SR_UIF        (1u << 0)
+#define STM32_TIM_CCMR1_OC1PE   (1u << 3)
+#define STM32_TIM_CCMR1_OC1M_MASK (7u << 4)
+#define STM32_TIM_CCMR1_OC1M(n) ((uint32_t)(n) << 4)
+
+typedef struct
+{
+	volatile uint32_t     CR1;
+	volatile uint32_t     CR2;
+	volatile uint32_t     SMCR;
+	volatile uint32_t     DIER;
+	volatile uint32_t     SR;
+	volatile uint32_t     EGR;
+	volatile uint32_t     CCMR1;
+	volatile uint32_t     CCMR2;
+	volatile uint32_t     CCER;
+	volatile uint32_t     CNT;
+	volatile uint32_t     PSC;
+	volatile uint32_t     ARR;
+	volatile uint32_t     RCR;
+	volatile uint32_t     CCR[4];
+	volatile uint32_t     BDTR;
+	volatile uint32_t     DCR;
+	volatile uint32_t     DMAR;
+}stm32_tim_t;
+
+/* GPT driver. */
+typedef uint32_t gptfreq_t;
+typedef uint32_t gptcnt_t;
+typedef struct GPTDriver GPTDriver;
+typedef void (*gptcallback_t)(GPTDriver *gptp);
+
+typedef struct
+{
+	gptfreq_t             frequency;      /** Counter clock, divides 1 GHz of simulated time. */
+	gptcallback_t         callback;       /** Called at the end of every period. */
+	uint32_t              cr2;
+	uint32_t              dier;
+}GPTConfig;
+
+struct GPTDriver
+{
+	const GPTConfig       *config;
+	stm32_tim_t           *tim;
+	stm32_tim_t           registers;      /** Storage of tim. */
+	bool                  running;        /** Counter is counting. */
+	bool                  one_shot;       /** Counter stops at the end of first period. */
+	gptcnt_t              interval;       /** Period, counter ticks. */
+	uint64_t              start_nsec;     /** Simulated time of counter start. */
+	uint64_t              periods;        /** Periods ended since start. */
+};
+
+extern GPTDriver GPTD1;
+extern GPTDriver GPTD2;
+
+void gptStart(GPTDriver *gptp, const GPTConfig *config);
+void gptStop(GPTDriver *gptp);
+void gptStartContinuous(GPTDriver *gptp, gptcnt_t interval);
+void gptStartContinuousI(GPTDriver *gptp, gptcnt_t interval);
+void gptStartOneShot(GPTDriver *gptp, gptcnt_t interval);
+void gptStartOneShotI(GPTDriver *gptp, gptcnt_t interval);
+void gptStopTimer(GPTDriver *gptp);
+void gptStopTimerI(GPTDriver *gptp);
+gptcnt_t gptGetCounterX(GPTDriver *gptp);
+
+/* PWM driver. */
+typedef uint32_t pwmcnt_t;
+typedef struct PWMDriver PWMDriver;
+typedef void (*pwmcallback_t)(PWMDriver *pwmp);
+
+#define PWM_OUTPUT_DISABLED     0U
+#define PWM_OUTPUT_ACTIVE_HIGH  1U
+#define PWM_OUTPUT_ACTIVE_LOW   2U
+
+typedef struct
+{
+	uint32_t              mode;           /** PWM_OUTPUT_*. */
+	pwmcallback_t         callback;
+}PWMChannelConfig;
+
+typedef struct
+{
+	uint32_t              frequency;
+	pwmcnt_t              period;
+	pwmcallback_t         callback;       /** Called by update event while periodic notification is enabled. */
+	PWMChannelConfig      channels[4];
+	uint32_t              cr2;
+	uint32_t              dier;
+}PWMConfig;
+
+struct PWMDriver
+{
+	const PWMConfig       *config;
+	pwmcnt_t              period;
+	stm32_tim_t           *tim;
+	stm32_tim_t           registers;      /** Storage of tim. */
+	uint32_t              active[4];      /** Active compare registers, CCR are preload ones. */
+};
+
+extern PWMDriver PWMD3;
+extern PWMDriver PWMD4;
+
+#define PWM_PERCENTAGE_TO_WIDTH(pwmp, percentage) ((pwmcnt_t)(((uint64_t)(pwmp)->period * (percentage)) / 10000u))
+
+void pwmStart(PWMDriver *pwmp, const PWMConfig *config);
+void pwmEnableChannel(PWMDriver *pwmp, uint32_t channel, pwmcnt_t width);
+void pwmEnableChannelI(PWMDriver *pwmp, uint32_t channel, pwmcnt_t width);
+void pwmEnablePeriodicNotificationI(PWMDriver *pwmp);
+void pwmDisablePeriodicNotificationI(PWMDriver *pwmp);
+
+/* DMA streams of DMA1, memory to timer DMAR only. */
+#define STM32_DMA_STREAM_ID(dma, stream) ((((dma) - 1u) * 7u) + ((stream) - 1u))
+#define STM32_DMA_STREAMS       7u
+
+#define STM32_DMA_ISR_TCIF      (1u << 1)
+#define STM32_DMA_ISR_HTIF      (1u << 2)
+
+#define STM32_DMA_CR_EN         (1u << 0)
+#define STM32_DMA_CR_TCIE       (1u << 1)
+#define STM32_DMA_CR_HTIE       (1u << 2)
+#define STM32_DMA_CR_DIR_M2P    (1u << 4)
+#define STM32_DMA_CR_CIRC       (1u << 5)
+#define STM32_DMA_CR_MINC       (1u << 7)
+#define STM32_DMA_CR_PSIZE_HWORD (1u << 8)
+#define STM32_DMA_CR_MSIZE_HWORD (1u << 10)
+#define STM32_DMA_CR_PL(n)      ((uint32_t)(n) << 12)
+
+typedef void (*stm32_dmaisr_t)(void *p, uint32_t flags);
+
+typedef struct
+{
+	volatile uint32_t     CCR;            /** Mode, STM32_DMA_CR_*. */
+}DMA_Channel_TypeDef;
+
+typedef struct
+{
+	DMA_Channel_TypeDef   *channel;       /** Registers of channel, as in ChibiOS. */
+	DMA_Channel_TypeDef   registers;      /** Storage of channel. */
+	stm32_dmaisr_t        callback;
+	void                  *param;
+	volatile uint32_t     *peripheral;
+	const uint16_t        *memory;        /** Half words. */
+	uint32_t              size;           /** Transfers of circular buffer. */
+	uint32_t              index;          /** Next transfer. */
+	uint32_t              flags;          /** Pending STM32_DMA_ISR_* flags, interrupt is called if enabled in CCR. */
+	bool                  allocated;
+}stm32_dma_stream_t;
+
+const stm32_dma_stream_t *dmaStreamAlloc(uint32_t id, uint32_t priority, stm32_dmaisr_t func, void *param);
+void dmaStreamSetPeripheral(const stm32_dma_stream_t *dmastp, volatile uint32_t *address);
+void dmaStreamSetMemory0(const stm32_dma_stream_t *dmastp, const void *address);
+void dmaStreamSetTransactionSize(const stm32_dma_stream_t *dmastp, uint32_t size);
+void dmaStreamSetMode(const stm32_dma_stream_t *dmastp, uint32_t mode);
+void dmaStreamEnable(const stm32_dma_stream_t *dmastp);
+void dmaStreamClearInterrupt(const stm32_dma_stream_t *dmastp);
+
+/* PAL driver. */
+typedef struct
+{
+	uint32_t              index;          /** Port number, GPIOA is 0. */
+}stm32_gpio_t;
+typedef stm32_gpio_t *ioportid_t;
+typedef uint32_t iopadid_t;
+typedef uint32_t iomode_t;
+typedef void (*palcallback_t)(void *arg);
+
+extern stm32_gpio_t shim_gpio[3];
+#define GPIOA                   (&shim_gpio[0])
+#define GPIOB                   (&shim_gpio[1])
+#define GPIOC                   (&shim_gpio[2])
+
+#define PAL_LOW                 0U
+#define PAL_HIGH                1U
+
+#define PAL_MODE_INPUT          0U
+#define PAL_MODE_INPUT_PULLUP   1U
+#define PAL_MODE_OUTPUT_PUSHPULL 2U
+#define PAL_MODE_STM32_ALTERNATE_PUSHPULL 3U
+
+#define PAL_EVENT_MODE_DISABLED      0U
+#define PAL_EVENT_MODE_RISING_EDGE   1U
+#define PAL_EVENT_MODE_FALLING_EDGE  2U
+#define PAL_EVENT_MODE_BOTH_EDGES    3U
+
+uint32_t palReadPad(ioportid_t port, iopadid_t pad);
+void palSetPadMode(ioportid_t port, iopadid_t pad, iomode_t mode);
+void palSetPadCallback(ioportid_t port, iopadid_t pad, palcallback_t cb, void *arg);
+void palSetPadCallbackI(ioportid_t port, iopadid_t pad, palcallback_t cb, void *arg);
+void palEnablePadEvent(ioportid_t port, iopadid_t pad, uint32_t mode);
+void palEnablePadEventI(ioportid_t port, iopadid_t pad, uint32_t mode);
+void palDisablePadEvent(ioportid_t port, iopadid_t pad);
+void palDisablePadEventI(ioportid_t port, iopadid_t pad);
+
+#endif //SHIM_HAL_H
@@ -0,0 +1,806 @@
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "hal.h"
+#include "shim.h"
+
+#define SHIM_NSEC_PER_SEC       1000000000u
+#define SHIM_THREADS_MAX        8u
+#define SHIM_PADS_MAX           8u
+#define SHIM_VIRTUAL_TIMERS_MAX 4u
+#define SHIM_NSEC_PER_SYSTICK   (SHIM_NSEC_PER_SEC / CH_CFG_ST_FREQUENCY)
+
+struct shim_thread
+{
+	tfunc_t               function;       /** Thread function, restarted after every wait. */
+	void                  *arg;           /** Argument of thread function. */
+	jmp_buf               context;        /** Unwinding of waiting thread. */
+	binary_semaphore_t    *waiting;       /** Semaphore which thread waits for. */
+	bool                  finished;       /** Thread function returned. */
+};
+
+typedef struct
+{
+	ioportid_t            port;
+	iopadid_t             pad;
+	uint32_t              level;          /** Electrical level. */
+	uint32_t              events;         /** Enabled edges, PAL_EVENT_MODE_*. */
+	palcallback_t         callback;       /** Pad event callback. */
+	void                  *arg;           /** Argument of callback. */
+}shim_pad_t;
+
+GPTDriver GPTD1;
+GPTDriver GPTD2;
+PWMDriver PWMD3;
+PWMDriver PWMD4;
+static stm32_dma_stream_t shim_dma_streams[STM32_DMA_STREAMS];
+stm32_gpio_t shim_gpio[3] = {{0}, {1}, {2}};
+
+static GPTDriver *const shim_timers[] = {&GPTD1, &GPTD2};
+static PWMDriver *const shim_pwms[] = {&PWMD3, &PWMD4};
+
+static struct
+{
+	uint64_t              now;                        /** Simulated time, nanoseconds. */
+	uint64_t              stop_time;                  /** Simulated time when MCU was stopped. */
+	bool                  stopped;                    /** Timers are frozen at stop_time. */
+	struct shim_thread    threads[SHIM_THREADS_MAX];
+	uint32_t              thread_count;
+	thread_t              *current;                   /** Running thread, NULL for test and interrupts. */
+	shim_pad_t            pads[SHIM_PADS_MAX];
+	uint32_t              pad_count;
+	virtual_timer_t       *virtual_timers[SHIM_VIRTUAL_TIMERS_MAX];
+	uint32_t              virtual_timer_count;
+	shim_statistics_t     statistics;
+}shim_context;
+
+
+void shim_panic(const char *reason)
+{
+	fprintf(stderr, "shim: %s\n", reason);
+	abort();
+}
+
+/* Threads. */
+
+static void shim_thread_run(thread_t *tp)
+{
+	thread_t *previous = shim_context.current;
+
+	shim_context.current = tp;
+	tp->waiting = NULL;
+	if (setjmp(tp->context) == 0)
+	{
+		tp->function(tp->arg);
+		tp->finished = true;
+	}
+	shim_context.current = previous;
+}
+
+/** Threads signaled by interrupt or by other thread run until all of them wait again. */
+static void shim_schedule(void)
+{
+	bool ran = true;
+	uint32_t i;
+
+	if (shim_context.current != NULL)
+	{
+		return;
+	}
+	while (ran)
+	{
+		ran = false;
+		for (i = 0; i < shim_context.thread_count; i++)
+		{
+			thread_t *tp = &shim_context.threads[i];
+			if (!tp->finished && (tp->waiting != NULL) && tp->waiting->signaled)
+			{
+				shim_thread_run(tp);
+				ran = true;
+			}
+		}
+	}
+}
+
+thread_t *chThdCreateStatic(void *wsp, size_t size, tprio_t prio, tfunc_t pf, void *arg)
+{
+	thread_t *tp;
+	(void)wsp;
+	(void)size;
+	(void)prio;
+
+	if (shim_context.thread_count >= SHIM_THREADS_MAX)
+	{
+		shim_panic("too many threads");
+	}
+	tp = &shim_context.threads[shim_context.thread_count++];
+	tp->function = pf;
+	tp->arg = arg;
+	tp->finished = false;
+	shim_thread_run(tp);
+	return tp;
+}
+
+void chRegSetThreadName(const char *name)
+{
+	(void)name;
+}
+
+void chBSemObjectInit(binary_semaphore_t *bsp, bool taken)
+{
+	bsp->signaled = !taken;
+}
+
+msg_t chBSemWait(binary_semaphore_t *bsp)
+{
+	if (bsp->signaled)
+	{
+		bsp->signaled = false;
+		return MSG_OK;
+	}
+	if (shim_context.current == NULL)
+	{
+		shim_panic("wait outside of thread");
+	}
+	shim_context.current->waiting = bsp;
+	longjmp(shim_context.current->context, 1);
+}
+
+void chBSemSignalI(binary_semaphore_t *bsp)
+{
+	bsp->signaled = true;
+}
+
+void chBSemSignal(binary_semaphore_t *bsp)
+{
+	bsp->signaled = true;
+	shim_schedule();
+}
+
+/* System. */
+
+void chSysLock(void)
+{
+}
+
+void chSysUnlock(void)
+{
+}
+
+void chSysLockFromISR(void)
+{
+}
+
+void chSysUnlockFromISR(void)
+{
+}
+
+/* Host cycles, so costs are comparable between runs on the same machine only. */
+rtcnt_t chSysGetRealtimeCounterX(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return (rtcnt_t)__rdtsc();
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (rtcnt_t)((uint64_t)ts.tv_sec * SHIM_NSEC_PER_SEC + (uint64_t)ts.tv_nsec);
+#endif
+}
+
+systimestamp_t chVTGetTimeStamp(void)
+{
+	return shim_context.now / SHIM_NSEC_PER_SYSTICK;
+}
+
+systimestamp_t chVTGetTimeStampI(void)
+{
+	return chVTGetTimeStamp();
+}
+
+systime_t chVTGetSystemTimeX(void)
+{
+	return (systime_t)chVTGetTimeStamp();
+}
+
+void chVTObjectInit(virtual_timer_t *vtp)
+{
+	uint32_t i;
+
+	vtp->armed = false;
+	for (i = 0; i < shim_context.virtual_timer_count; i++)
+	{
+		if (shim_context.virtual_timers[i] == vtp)
+		{
+			return;
+		}
+	}
+	if (shim_context.virtual_timer_count >= SHIM_VIRTUAL_TIMERS_MAX)
+	{
+		shim_panic("too many virtual timers");
+	}
+	shim_context.virtual_timers[shim_context.virtual_timer_count++] = vtp;
+}
+
+/* Delay starts at the current system tick, as in kernel. */
+void chVTSetI(virtual_timer_t *vtp, sysinterval_t delay, vtfunc_t vtfunc, void *par)
+{
+	vtp->armed = true;
+	vtp->due = (chVTGetTimeStamp() + ((delay != 0) ? delay : 1u)) * SHIM_NSEC_PER_SYSTICK;
+	vtp->func = vtfunc;
+	vtp->par = par;
+}
+
+void chVTResetI(virtual_timer_t *vtp)
+{
+	vtp->armed = false;
+}
+
+bool chVTIsArmedI(const virtual_timer_t *vtp)
+{
+	return vtp->armed;
+}
+
+/* Event sources, broadcast flags are only collected. */
+
+void chEvtObjectInit(event_source_t *esp)
+{
+	esp->flags = 0;
+}
+
+void chEvtBroadcastFlagsI(event_source_t *esp, eventflags_t flags)
+{
+	esp->flags |= flags;
+}
+
+/* Objects FIFO, never blocks. */
+
+void chFifoObjectInit(objects_fifo_t *ofp, size_t objsize, size_t objn, void *objbuf, msg_t *msgbuf)
+{
+	if (objn > 32u)
+	{
+		shim_panic("too many FIFO objects");
+	}
+	ofp->object_size = objsize;
+	ofp->objects = objn;
+	ofp->buffer = objbuf;
+	ofp->messages = msgbuf;
+	ofp->free = (objn == 32u) ? 0xffffffffu : ((1u << objn) - 1u);
+	ofp->head = 0;
+	ofp->tail = 0;
+}
+
+void *chFifoTakeObjectTimeout(objects_fifo_t *ofp, sysinterval_t timeout)
+{
+	uint32_t index;
+	(void)timeout;
+
+	if (ofp->free == 0)
+	{
+		return NULL;
+	}
+	index = (uint32_t)__builtin_ctz(ofp->free);
+	ofp->free &= ~(1u << index);
+	return ofp->buffer + index * ofp->object_size;
+}
+
+void chFifoSendObject(objects_fifo_t *ofp, void *objp)
+{
+	ofp->messages[ofp->head % ofp->objects] = (msg_t)(((uint8_t *)objp - ofp->buffer) / ofp->object_size);
+	ofp->head++;
+}
+
+msg_t chFifoReceiveObjectTimeout(objects_fifo_t *ofp, void **objpp, sysinterval_t timeout)
+{
+	(void)timeout;
+
+	if (ofp->head == ofp->tail)
+	{
+		return MSG_TIMEOUT;
+	}
+	*objpp = ofp->buffer + (size_t)ofp->messages[ofp->tail % ofp->objects] * ofp->object_size;
+	ofp->tail++;
+	return MSG_OK;
+}
+
+void chFifoReturnObject(objects_fifo_t *ofp, void *objp)
+{
+	ofp->free |= 1u << (((uint8_t *)objp - ofp->buffer) / ofp->object_size);
+}
+
+/* GPT. */
+
+static uint64_t shim_ticks_to_nsec(uint64_t ticks, gptfreq_t frequency)
+{
+	return (ticks / frequency) * SHIM_NSEC_PER_SEC + ((ticks % frequency) * SHIM_NSEC_PER_SEC + frequency - 1u) / frequency;
+}
+
+static uint64_t shim_nsec_to_ticks(uint64_t nsec, gptfreq_t frequency)
+{
+	return (nsec / SHIM_NSEC_PER_SEC) * frequency + (nsec % SHIM_NSEC_PER_SEC) * frequency / SHIM_NSEC_PER_SEC;
+}
+
+/** Simulated time of the end of current period. */
+static uint64_t shim_timer_event(const GPTDriver *gptp)
+{
+	return gptp->start_nsec + shim_ticks_to_nsec((gptp->periods + 1u) * gptp->interval, gptp->config->frequency);
+}
+
+void gptStart(GPTDriver *gptp, const GPTConfig *config)
+{
+	gptp->config = config;
+	gptp->tim = &gptp->registers;
+	gptp->running = false;
+}
+
+void gptStop(GPTDriver *gptp)
+{
+	gptp->running = false;
+}
+
+static void shim_timer_start(GPTDriver *gptp, gptcnt_t interval, bool one_shot)
+{
+	gptp->running = true;
+	gptp->one_shot = one_shot;
+	gptp->interval = interval;
+	gptp->start_nsec = shim_context.now;
+	gptp->periods = 0;
+}
+
+void gptStartContinuous(GPTDriver *gptp, gptcnt_t interval)
+{
+	shim_timer_start(gptp, interval, false);
+}
+
+void gptStartContinuousI(GPTDriver *gptp, gptcnt_t interval)
+{
+	shim_timer_start(gptp, interval, false);
+}
+
+void gptStartOneShot(GPTDriver *gptp, gptcnt_t interval)
+{
+	shim_timer_start(gptp, interval, true);
+}
+
+void gptStartOneShotI(GPTDriver *gptp, gptcnt_t interval)
+{
+	shim_timer_start(gptp, interval, true);
+}
+
+void gptStopTimer(GPTDriver *gptp)
+{
+	gptp->running = false;
+}
+
+void gptStopTimerI(GPTDriver *gptp)
+{
+	gptp->running = false;
+}
+
+gptcnt_t gptGetCounterX(GPTDriver *gptp)
+{
+	const uint64_t now = shim_context.stopped ? shim_context.stop_time : shim_context.now;
+
+	if (!gptp->running)
+	{
+		return 0;
+	}
+	return (gptcnt_t)(shim_nsec_to_ticks(now - gptp->start_nsec, gptp->config->frequency) -
+	                  gptp->periods * gptp->interval);
+}
+
+/* PWM, as pwm_lld_start() of STM32: edge aligned PWM mode 1 with preload on all channels. */
+
+void pwmStart(PWMDriver *pwmp, const PWMConfig *config)
+{
+	const uint32_t mode = STM32_TIM_CCMR1_OC1M(6) | STM32_TIM_CCMR1_OC1PE;
+
+	pwmp->config = config;
+	pwmp->period = config->period;
+	pwmp->tim = &pwmp->registers;
+	pwmp->registers = (stm32_tim_t){0};
+	memset(pwmp->active, 0, sizeof(pwmp->active));
+	pwmp->tim->ARR = config->period - 1u;
+	pwmp->tim->CR2 = config->cr2;
+	pwmp->tim->DIER = config->dier;
+	pwmp->tim->CCMR1 = mode | (mode << 8);
+	pwmp->tim->CCMR2 = mode | (mode << 8);
+}
+
+void pwmEnableChannelI(PWMDriver *pwmp, uint32_t channel, pwmcnt_t width)
+{
+	pwmp->tim->CCR[channel] = width;
+}
+
+void pwmEnableChannel(PWMDriver *pwmp, uint32_t channel, pwmcnt_t width)
+{
+	pwmEnableChannelI(pwmp, channel, width);
+}
+
+void pwmEnablePeriodicNotificationI(PWMDriver *pwmp)
+{
+	pwmp->tim->DIER |= STM32_TIM_DIER_UIE;
+}
+
+void pwmDisablePeriodicNotificationI(PWMDriver *pwmp)
+{
+	pwmp->tim->DIER &= ~STM32_TIM_DIER_UIE;
+}
+
+/* DMA. */
+
+const stm32_dma_stream_t *dmaStreamAlloc(uint32_t id, uint32_t priority, stm32_dmaisr_t func, void *param)
+{
+	stm32_dma_stream_t *stream;
+	(void)priority;
+
+	if ((id >= STM32_DMA_STREAMS) || shim_dma_streams[id].allocated)
+	{
+		return NULL;
+	}
+	stream = &shim_dma_streams[id];
+	*stream = (stm32_dma_stream_t){.callback = func, .param = param, .allocated = true};
+	stream->channel = &stream->registers;
+	return stream;
+}
+
+void dmaStreamSetPeripheral(const stm32_dma_stream_t *dmastp, volatile uint32_t *address)
+{
+	((stm32_dma_stream_t *)dmastp)->peripheral = address;
+}
+
+void dmaStreamSetMemory0(const stm32_dma_stream_t *dmastp, const void *address)
+{
+	((stm32_dma_stream_t *)dmastp)->memory = address;
+}
+
+void dmaStreamSetTransactionSize(const stm32_dma_stream_t *dmastp, uint32_t size)
+{
+	((stm32_dma_stream_t *)dmastp)->size = size;
+}
+
+void dmaStreamSetMode(const stm32_dma_stream_t *dmastp, uint32_t mode)
+{
+	dmastp->channel->CCR = mode;
+}
+
+void dmaStreamEnable(const stm32_dma_stream_t *dmastp)
+{
+	dmastp->channel->CCR |= STM32_DMA_CR_EN;
+	((stm32_dma_stream_t *)dmastp)->index = 0;
+}
+
+void dmaStreamClearInterrupt(const stm32_dma_stream_t *dmastp)
+{
+	((stm32_dma_stream_t *)dmastp)->flags = 0;
+}
+
+/** Half or the whole circular buffer is sent, flags are pending until interrupt enabled in CCR serves them. */
+static void shim_dma_transferred(stm32_dma_stream_t *stream)
+{
+	uint32_t enabled = 0;
+	uint32_t flags;
+
+	stream->index++;
+	if (stream->index == stream->size / 2u)
+	{
+		stream->flags |= STM32_DMA_ISR_HTIF;
+	}
+	else if (stream->index == stream->size)
+	{
+		stream->flags |= STM32_DMA_ISR_TCIF;
+		stream->index = 0;
+	}
+	enabled |= (stream->channel->CCR & STM32_DMA_CR_HTIE) ? STM32_DMA_ISR_HTIF : 0u;
+	enabled |= (stream->channel->CCR & STM32_DMA_CR_TCIE) ? STM32_DMA_ISR_TCIF : 0u;
+	if (((stream->flags & enabled) == 0) || (stream->callback == NULL))
+	{
+		return;
+	}
+	/* Handler of ChibiOS passes and clears all flags of the channel. */
+	flags = stream->flags;
+	stream->flags = 0;
+	stream->callback(stream->param, flags);
+	shim_context.statistics.dma_interrupts++;
+}
+
+/* PAL. */
+
+static shim_pad_t *shim_pad(ioportid_t port, iopadid_t pad)
+{
+	uint32_t i;
+
+	for (i = 0; i < shim_context.pad_count; i++)
+	{
+		if ((shim_context.pads[i].port == port) && (shim_context.pads[i].pad == pad))
+		{
+			return &shim_context.pads[i];
+		}
+	}
+	if (shim_context.pad_count >= SHIM_PADS_MAX)
+	{
+		shim_panic("too many pads");
+	}
+	shim_context.pads[shim_context.pad_count].port = port;
+	shim_context.pads[shim_context.pad_count].pad = pad;
+	shim_context.pads[shim_context.pad_count].level = PAL_HIGH;
+	return &shim_context.pads[shim_context.pad_count++];
+}
+
+uint32_t palReadPad(ioportid_t port, iopadid_t pad)
+{
+	return shim_pad(port, pad)->level;
+}
+
+void palSetPadMode(ioportid_t port, iopadid_t pad, iomode_t mode)
+{
+	(void)shim_pad(port, pad);
+	(void)mode;
+}
+
+void palSetPadCallbackI(ioportid_t port, iopadid_t pad, palcallback_t cb, void *arg)
+{
+	shim_pad_t *line = shim_pad(port, pad);
+
+	line->callback = cb;
+	line->arg = arg;
+}
+
+void palSetPadCallback(ioportid_t port, iopadid_t pad, palcallback_t cb, void *arg)
+{
+	palSetPadCallbackI(port, pad, cb, arg);
+}
+
+void palEnablePadEventI(ioportid_t port, iopadid_t pad, uint32_t mode)
+{
+	shim_pad(port, pad)->events = mode;
+}
+
+void palEnablePadEvent(ioportid_t port, iopadid_t pad, uint32_t mode)
+{
+	palEnablePadEventI(port, pad, mode);
+}
+
+void palDisablePadEventI(ioportid_t port, iopadid_t pad)
+{
+	shim_pad(port, pad)->events = PAL_EVENT_MODE_DISABLED;
+}
+
+void palDisablePadEvent(ioportid_t port, iopadid_t pad)
+{
+	palDisablePadEventI(port, pad);
+}
+
+/* Test side. */
+
+/* Compare value which output follows: active register, or preload one at once if preload is disabled. */
+static uint32_t shim_pwm_compare(PWMDriver *pwmp, uint32_t channel)
+{
+	const uint32_t ccmr = (channel < 2u) ? pwmp->tim->CCMR1 : pwmp->tim->CCMR2;
+	const uint32_t preload = STM32_TIM_CCMR1_OC1PE << ((channel & 1u) ? 8u : 0u);
+
+	return (ccmr & preload) ? pwmp->active[channel] : pwmp->tim->CCR[channel];
+}
+
+/* Preload compare registers are copied to active ones, unless update is disabled by CR1 UDIS. */
+static bool shim_pwm_transfer(PWMDriver *pwmp)
+{
+	uint32_t i;
+
+	if (pwmp->tim->CR1 & STM32_TIM_CR1_UDIS)
+	{
+		return false;
+	}
+	for (i = 0; i < 4u; i++)
+	{
+		pwmp->active[i] = pwmp->tim->CCR[i];
+	}
+	return true;
+}
+
+/*
+ * Update event of master timer updates slave timers in reset mode too, by trigger output.
+ * Then timer burst of DBL + 1 transfers through DMAR goes to registers from DBA, for the next period.
+ * Period callback follows, compare values written by it take effect at once,
+ * as pwm.c writes them with preload disabled.
+ */
+void shim_pwm_update(PWMDriver *pwmp)
+{
+	stm32_tim_t *tim = pwmp->tim;
+	uint32_t before[sizeof(shim_pwms) / sizeof(shim_pwms[0])][4];
+	uint32_t timer;
+	uint32_t i;
+
+	if (!shim_pwm_transfer(pwmp))
+	{
+		return;
+	}
+	for (timer = 0; timer < sizeof(shim_pwms) / sizeof(shim_pwms[0]); timer++)
+	{
+		PWMDriver *slave = shim_pwms[timer];
+		if ((slave != pwmp) && (slave->tim != NULL) && ((slave->tim->SMCR & STM32_TIM_SMCR_SMS(7)) == STM32_TIM_SMCR_SMS(4)))
+		{
+			(void)shim_pwm_transfer(slave);
+		}
+	}
+	if (tim->DIER & STM32_TIM_DIER_UDE)
+	{
+		for (i = 0; i < STM32_DMA_STREAMS; i++)
+		{
+			stm32_dma_stream_t *stream = &shim_dma_streams[i];
+			const uint32_t base = tim->DCR & 0x1fu;
+			const uint32_t count = ((tim->DCR >> 8) & 0x1fu) + 1u;
+			uint32_t transfer;
+
+			if (((stream->registers.CCR & STM32_DMA_CR_EN) == 0) || (stream->peripheral != &tim->DMAR))
+			{
+				continue;
+			}
+			for (transfer = 0; transfer < count; transfer++)
+			{
+				((volatile uint32_t *)tim)[base + transfer] = stream->memory[stream->index];
+				shim_dma_transferred(stream);
+			}
+		}
+	}
+	if ((tim->DIER & STM32_TIM_DIER_UIE) && (pwmp->config->callback != NULL))
+	{
+		for (timer = 0; timer < sizeof(shim_pwms) / sizeof(shim_pwms[0]); timer++)
+		{
+			for (i = 0; i < 4u; i++)
+			{
+				before[timer][i] = shim_pwms[timer]->registers.CCR[i];
+			}
+		}
+		pwmp->config->callback(pwmp);
+		for (timer = 0; timer < sizeof(shim_pwms) / sizeof(shim_pwms[0]); timer++)
+		{
+			for (i = 0; i < 4u; i++)
+			{
+				if (shim_pwms[timer]->registers.CCR[i] != before[timer][i])
+				{
+					shim_pwms[timer]->active[i] = shim_pwms[timer]->registers.CCR[i];
+				}
+			}
+		}
+	}
+}
+
+/* PWM mode 1 is active while counter is below compare value, PWM mode 2 from compare value. */
+bool shim_pwm_output(PWMDriver *pwmp, uint32_t channel, uint32_t counter)
+{
+	const uint32_t ccmr = (channel < 2u) ? pwmp->tim->CCMR1 : pwmp->tim->CCMR2;
+	const uint32_t mode = (ccmr >> ((channel & 1u) ? 12u : 4u)) & 7u;
+	const uint32_t compare = shim_pwm_compare(pwmp, channel);
+
+	return (mode == 7u) ? (counter >= compare) : (counter < compare);
+}
+
+uint64_t shim_now(void)
+{
+	return shim_context.now;
+}
+
+void shim_advance(uint64_t nsec)
+{
+	const uint64_t target = shim_context.now + nsec;
+
+	while (true)
+	{
+		GPTDriver *next = NULL;
+		virtual_timer_t *next_vt = NULL;
+		uint64_t next_time = target;
+		rtcnt_t start;
+		uint32_t i;
+
+		for (i = 0; i < sizeof(shim_timers) / sizeof(shim_timers[0]); i++)
+		{
+			GPTDriver *gptp = shim_timers[i];
+			if (gptp->running && !shim_context.stopped && (shim_timer_event(gptp) <= next_time))
+			{
+				next = gptp;
+				next_time = shim_timer_event(gptp);
+			}
+		}
+		for (i = 0; i < shim_context.virtual_timer_count; i++)
+		{
+			virtual_timer_t *vtp = shim_context.virtual_timers[i];
+			if (vtp->armed && !shim_context.stopped && (vtp->due < next_time))
+			{
+				next = NULL;
+				next_vt = vtp;
+				next_time = vtp->due;
+			}
+		}
+		if ((next == NULL) && (next_vt == NULL))
+		{
+			break;
+		}
+
+		shim_context.now = next_time;
+		if (next_vt != NULL)
+		{
+			next_vt->armed = false;
+			next_vt->func(next_vt, next_vt->par);
+			shim_context.statistics.kernel_interrupts++;
+			shim_schedule();
+			continue;
+		}
+		next->periods++;
+		if (next->one_shot)
+		{
+			next->running = false;
+		}
+		if (next->config->callback != NULL)
+		{
+			start = chSysGetRealtimeCounterX();
+			next->config->callback(next);
+			shim_context.statistics.timer_cycles += (rtcnt_t)(chSysGetRealtimeCounterX() - start);
+			shim_context.statistics.timer_interrupts++;
+		}
+		shim_schedule();
+	}
+	shim_context.now = target;
+}
+
+void shim_set_pad(ioportid_t port, iopadid_t pad, uint32_t level)
+{
+	shim_pad_t *line = shim_pad(port, pad);
+	const uint32_t edge = (level == PAL_HIGH) ? PAL_EVENT_MODE_RISING_EDGE : PAL_EVENT_MODE_FALLING_EDGE;
+	rtcnt_t start;
+
+	if (line->level == level)
+	{
+		return;
+	}
+	line->level = level;
+	if (((line->events & edge) == 0) || (line->callback == NULL))
+	{
+		return;
+	}
+	start = chSysGetRealtimeCounterX();
+	line->callback(line->arg);
+	shim_context.statistics.pad_cycles += (rtcnt_t)(chSysGetRealtimeCounterX() - start);
+	shim_context.statistics.pad_interrupts++;
+	shim_schedule();
+}
+
+void shim_stop(void)
+{
+	shim_context.stopped = true;
+	shim_context.stop_time = shim_context.now;
+}
+
+/* Timers continue from their values at stop, as if they were started later by time of stop, virtual timers too. */
+void shim_wake(void)
+{
+	uint32_t i;
+
+	if (!shim_context.stopped)
+	{
+		return;
+	}
+	shim_context.stopped = false;
+	for (i = 0; i < sizeof(shim_timers) / sizeof(shim_timers[0]); i++)
+	{
+		shim_timers[i]->start_nsec += shim_context.now - shim_context.stop_time;
+	}
+	for (i = 0; i < shim_context.virtual_timer_count; i++)
+	{
+		shim_context.virtual_timers[i]->due += shim_context.now - shim_context.stop_time;
+	}
+}
+
+void shim_get_statistics(shim_statistics_t *statistics)
+{
+	*statistics = shim_context.statistics;
+}
+
+void shim_reset_statistics(void)
+{
+	shim_context.statistics = (shim_statistics_t){0};
+}
@@ -0,0 +1,35 @@
+#ifndef SHIM_H
+#define SHIM_H
+#include <stdint.h>
+#include <stdbool.h>
+#include "hal.h"
+
+#define SHIM_NSEC_PER_USEC      1000u
+#define SHIM_NSEC_PER_MSEC      1000000u
+
+/*
+ * Test side of host shim.
+ * Simulated time passes only by shim_advance(), timer periods and virtual timers ended meanwhile call their callbacks in order.
+ * Every interrupt (timer callback or pad event) is followed by threads which were signaled by it.
+ */
+typedef struct
+{
+	uint32_t              pad_interrupts;     /** Pad event callbacks. */
+	uint64_t              pad_cycles;         /** Host cycles spent in pad event callbacks. */
+	uint32_t              timer_interrupts;   /** Timer period callbacks. */
+	uint64_t              timer_cycles;       /** Host cycles spent in timer period callbacks. */
+	uint32_t              dma_interrupts;     /** DMA half and full transfer callbacks. */
+	uint32_t              kernel_interrupts;  /** Virtual timer callbacks, by system timer interrupt. */
+}shim_statistics_t;
+
+uint64_t shim_now(void); /** Simulated time, nanoseconds. */
+void shim_advance(uint64_t nsec);
+void shim_set_pad(ioportid_t port, iopadid_t pad, uint32_t level); /** Pad event callback is called if edge is enabled. */
+void shim_stop(void); /** STOP mode of MCU: GPT and virtual timers don't count till shim_wake(). */
+void shim_wake(void);
+void shim_pwm_update(PWMDriver *pwmp); /** Update event: preload compare values become active, DMA burst to timer, then period callback if notification is enabled. */
+bool shim_pwm_output(PWMDriver *pwmp, uint32_t channel, uint32_t counter); /** Output is active at counter value. */
+void shim_get_statistics(shim_statistics_t *statistics);
+void shim_reset_statistics(void);
+
+#endif //SHIM_H